@@ -53,14 +53,26 @@
 #define UTIL_WEIGHT .40
 
 /* 
- * Alignment requirement in bytes
+ * Alignment requirement in bytes, that of max_align_t on x86-64, which
+ * the allocator must meet to stand in for malloc
  */
-#define ALIGNMENT 8
+#define ALIGNMENT 16
 
 /* 
- * Maximum heap size in bytes 
+ * Maximum heap size in bytes.  This much address space is reserved up
+ * front, but memory is only committed as the heap grows into it.  mm.c
+ * links free blocks by 32-bit offsets in units of ALIGNMENT, which reach
+ * no further.
  */
-#define MAX_HEAP (20*(1<<20))  /* 20 MB */
+#define MAX_HEAP ((size_t)1 << 36)  /* 64 GB */
+
+/*
+ * The heap is committed this many bytes at a time, and its start is
+ * aligned to it.  With USE_HUGEPAGES set, the kernel is asked to back the
+ * heap with transparent huge pages of this size.
+ */
+#define HEAP_COMMIT (1 << 21)  /* 2 MB */
+#define USE_HUGEPAGES 1
 
 /*****************************************************************************
  * Set exactly one of these USE_xxx constants to "1" to select a timing method
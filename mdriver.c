@@ -7,6 +7,7 @@
  * Copyright (c) 2002, R. Bryant and D. O'Hallaron, All rights reserved.
  * May not be used, modified, or copied without permission.
  */
+#include <limits.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -82,6 +83,8 @@ typedef struct {
 
     /* defined only for the student malloc package */
     double util;     /* space utilization for this trace (always 0 for libc) */
+    double copied;   /* payload bytes realloc copied to move blocks */
+    double avoided;  /* payload bytes realloc kept in place when growing */
 
     /* Note: secs and util are only defined if valid is true */
 } stats_t; 
@@ -119,11 +122,14 @@ static void free_trace(trace_t *trace);
 /* Routines for evaluating correctnes, space utilization, and speed 
    of the student's malloc package in mm.c */
 static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges);
-static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges);
+static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges,
+			   stats_t *stats);
 static void eval_mm_speed(void *ptr);
 
 /* Various helper routines */
 static void printresults(int n, stats_t *stats);
+static int parse_orders(char *arg, struct mm_config *cfg);
+static int parse_count(const char *arg, unsigned *count);
 static void usage(void);
 static void unix_error(char *msg);
 static void malloc_error(int tracenum, int opnum, char *msg);
@@ -145,6 +151,7 @@ int main(int argc, char **argv)
 
     int team_check = 1;  /* If set, check team structure (reset by -a) */
     int autograder = 0;  /* If set, emit summary info for autograder (-g) */
+    struct mm_config mm_cfg; /* free list policy (set by -o and -k) */
 
     /* temporaries used to compute the performance index */
     double secs, ops, util, avg_mm_util, avg_mm_throughput, p1, p2, perfindex;
@@ -153,7 +160,8 @@ int main(int argc, char **argv)
     /* 
      * Read and interpret the command line arguments 
      */
-    while ((c = getopt(argc, argv, "gf:t:avVh")) != EOF) {
+    mm_get_config(&mm_cfg);
+    while ((c = getopt(argc, argv, "gf:t:o:k:avVh")) != EOF) {
         switch (c) {
 	case 'g': /* Generate summary info for the autograder */
 	    autograder = 1;
@@ -176,6 +184,18 @@ int main(int argc, char **argv)
         case 'a': /* Don't check team structure */
             team_check = 0;
             break;
+	case 'o': /* Order in which each size class hands out blocks */
+	    if (parse_orders(optarg, &mm_cfg) < 0) {
+		usage();
+		exit(1);
+	    }
+	    break;
+	case 'k': /* Free blocks scanned for the best fit */
+	    if (parse_count(optarg, &mm_cfg.fit_scan) < 0) {
+		usage();
+		exit(1);
+	    }
+	    break;
         case 'v': /* Print per-trace performance breakdown */
             verbose = 1;
             break;
@@ -190,6 +210,8 @@ int main(int argc, char **argv)
             exit(1);
         }
     }
+    if (mm_set_config(&mm_cfg) < 0)
+	app_error("mm_set_config failed");
 	
     /* 
      * Check and print team info 
@@ -254,7 +276,7 @@ int main(int argc, char **argv)
 	if (mm_stats[i].valid) {
 	    if (verbose > 1)
 		printf("efficiency, ");
-	    mm_stats[i].util = eval_mm_util(trace, i, &ranges);
+	    mm_stats[i].util = eval_mm_util(trace, i, &ranges, &mm_stats[i]);
 	    speed_params.trace = trace;
 	    speed_params.ranges = ranges;
 	    if (verbose > 1)
@@ -352,9 +374,13 @@ static int add_range(range_t **ranges, char *lo, int size,
         return 0;
     }
 
-    /* The payload must lie within the extent of the heap */
-    if ((lo < (char *)mem_heap_lo()) || (lo > (char *)mem_heap_hi()) || 
-	(hi < (char *)mem_heap_lo()) || (hi > (char *)mem_heap_hi())) {
+    /* 
+     * The payload must lie within the extent of the heap, or within a
+     * huge block that mm.c mapped for it on its own
+     */
+    if ((lo >= (char *)mem_heap_lo()) && (lo <= (char *)mem_heap_hi()) ?
+	(hi > (char *)mem_heap_hi()) :
+	(!mm_owns(lo) || (size_t)size > mm_usable_size(lo))) {
 	sprintf(msg, "Payload (%p:%p) lies outside heap (%p:%p)",
 		lo, hi, mem_heap_lo(), mem_heap_hi());
 	malloc_error(tracenum, opnum, msg);
@@ -652,9 +678,11 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
  *   package on the trace. Note that our implementation of mem_sbrk() 
  *   doesn't allow the students to decrement the brk pointer, so brk
  *   is always the high water mark of the heap. 
- *   
+ *   It also records in "stats" how many payload bytes realloc copied,
+ *   and how many it avoided copying by growing a block in place.
  */
-static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
+static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges,
+			   stats_t *stats)
 {   
     unsigned i;
     int index;
@@ -705,6 +733,12 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 	    if ((newp = mm_realloc(oldp,newsize)) == NULL)
 		app_error("mm_realloc failed in eval_mm_util");
 
+	    /* Count the old payload that a growing block moved or kept */
+	    if (newp != oldp)
+		stats->copied += (oldsize < newsize) ? oldsize : newsize;
+	    else if (newsize > oldsize)
+		stats->avoided += oldsize;
+
 	    /* Remember region and size */
 	    trace->blocks[index] = newp;
 	    trace->block_sizes[index] = newsize;
@@ -737,7 +771,9 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
         }
     }
 
-    return ((double)max_total_size / (double)mem_heapsize());
+    /* Huge blocks are mapped outside the heap, but count against it */
+    return ((double)max_total_size /
+	    (double)(mem_heapsize() + mem_mapsize()));
 }
 
 
@@ -802,56 +838,116 @@ static void printresults(int n, stats_t *stats)
     double secs = 0;
     double ops = 0;
     double util = 0;
+    double copied = 0;
+    double avoided = 0;
 
     /* Print the individual results for each trace */
     /* All the space before the last number on each line is added by 
      * Zheng Cai, for better formatting */
-    printf("%5s%7s %5s%8s%10s %6s\n", 
-	   "trace", " valid", "util", "ops", "secs", "Kops");
+    printf("%5s%7s %5s%8s%10s %6s %8s %8s\n", 
+	   "trace", " valid", "util", "ops", "secs", "Kops", "copyKB",
+	   "savedKB");
     for (i=0; i < n; i++) {
 	if (stats[i].valid) {
-	    printf("%2d%10s%5.0f%%%8.0f%10.6f %6.0f\n", 
+	    printf("%2d%10s%5.0f%%%8.0f%10.6f %6.0f %8.0f %8.0f\n", 
 		   i,
 		   "yes",
 		   stats[i].util*100.0,
 		   stats[i].ops,
 		   stats[i].secs,
-		   (stats[i].ops/1e3)/stats[i].secs);
+		   (stats[i].ops/1e3)/stats[i].secs,
+		   stats[i].copied/1e3,
+		   stats[i].avoided/1e3);
 	    secs += stats[i].secs;
 	    ops += stats[i].ops;
 	    util += stats[i].util;
+	    copied += stats[i].copied;
+	    avoided += stats[i].avoided;
 	}
 	else {
-	    printf("%2d%10s%6s%8s%10s %6s\n", 
+	    printf("%2d%10s%6s%8s%10s %6s %8s %8s\n", 
 		   i,
 		   "no",
 		   "-",
 		   "-",
 		   "-",
+		   "-",
+		   "-",
 		   "-");
 	}
     }
 
     /* Print the aggregate results for the set of traces */
     if (errors == 0) {
-	printf("%12s%5.0f%%%8.0f%10.6f %6.0f\n", 
+	printf("%12s%5.0f%%%8.0f%10.6f %6.0f %8.0f %8.0f\n", 
 	       "Total       ",
 	       (util/n)*100.0,
 	       ops, 
 	       secs,
-	       (ops/1e3)/secs);
+	       (ops/1e3)/secs,
+	       copied/1e3,
+	       avoided/1e3);
     }
     else {
-	printf("%12s%6s%8s%10s %6s\n", 
+	printf("%12s%6s%8s%10s %6s %8s %8s\n", 
 	       "Total       ",
 	       "-", 
 	       "-", 
 	       "-", 
+	       "-",
+	       "-",
 	       "-");
     }
 
 }
 
+/*
+ * parse_orders - Set the free list order of each size class from a comma
+ *     separated list of fifo, lifo or addr.  The last order given also
+ *     applies to every larger class.  Returns -1 if the list is invalid.
+ */
+static int parse_orders(char *arg, struct mm_config *cfg)
+{
+    enum mm_order order = MM_ORDER_FIFO;
+    char *name;
+    int i;
+
+    for (i = 0; i < MM_ORDER_CLASSES; i++) {
+	if ((name = strsep(&arg, ",")) != NULL) {
+	    if (!strcmp(name, "fifo"))
+		order = MM_ORDER_FIFO;
+	    else if (!strcmp(name, "lifo"))
+		order = MM_ORDER_LIFO;
+	    else if (!strcmp(name, "addr"))
+		order = MM_ORDER_ADDRESS;
+	    else
+		return -1;
+	}
+	cfg->order[i] = order;
+    }
+    return (arg == NULL) ? 0 : -1;
+}
+
+/*
+ * parse_count - Parse a decimal count that fits an unsigned int into
+ *     *count.  Returns -1, leaving *count alone, if "arg" is not one.
+ */
+static int parse_count(const char *arg, unsigned *count)
+{
+    unsigned long n;
+    char *end;
+
+    /* strtoul would negate a leading minus sign instead of failing. */
+    if (*arg < '0' || *arg > '9')
+	return -1;
+    errno = 0;
+    n = strtoul(arg, &end, 10);
+    if (errno != 0 || *end != '\0' || n > UINT_MAX)
+	return -1;
+    *count = n;
+    return 0;
+}
+
 /* 
  * app_error - Report an arbitrary application error
  */
@@ -884,12 +980,16 @@ void malloc_error(int tracenum, int opnum, char *msg)
  */
 static void usage(void) 
 {
-    fprintf(stderr, "Usage: mdriver [-aghvV] [-f <file>] [-t <dir>]\n");
+    fprintf(stderr, "Usage: mdriver [-aghvV] [-f <file>] [-t <dir>] [-o <list>] [-k <n>]\n");
     fprintf(stderr, "Options\n");
     fprintf(stderr, "\t-a         Don't check the team structure.\n");
     fprintf(stderr, "\t-f <file>  Use <file> as the trace file.\n");
     fprintf(stderr, "\t-g         Generate summary info for autograder.\n");
     fprintf(stderr, "\t-h         Print this message.\n");
+    fprintf(stderr, "\t-k <n>     Scan <n> free blocks for the best fit.\n");
+    fprintf(stderr, "\t-o <list>  Free list order of each size class from 16 bytes up:\n");
+    fprintf(stderr, "\t           fifo, lifo or addr, separated by commas. The\n");
+    fprintf(stderr, "\t           last one also applies to the larger classes.\n");
     fprintf(stderr, "\t-t <dir>   Directory to find default traces.\n");
     fprintf(stderr, "\t-v         Print per-trace performance breakdowns.\n");
     fprintf(stderr, "\t-V         Print additional debug info.\n");
@@ -3,7 +3,9 @@
  *            allows us to interleave calls from the student's malloc package 
  *            with the system's malloc package in libc.
  */
+#define _GNU_SOURCE		/* For mremap */
 #include <stdio.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <assert.h>
 #include <unistd.h>
@@ -18,20 +20,51 @@
 static char *mem_start_brk;  /* points to first byte of heap */
 static char *mem_brk;        /* points to last byte of heap */
 static char *mem_max_addr;   /* largest legal heap address */ 
+static char *mem_fresh_brk;  /* highest brk so far; zero from here up */
+static char *mem_commit_brk; /* end of the committed part of the heap */
+static size_t mem_map_bytes; /* bytes now mapped by mem_map */
+static size_t mem_map_peak;  /* most bytes mapped at once since reset */
+
+static int mem_commit(char *end);
+static void mem_map_count(size_t oldsize, size_t newsize);
 
 /* 
  * mem_init - initialize the memory system model
  */
 void mem_init(void)
 {
-    /* allocate the storage we will use to model the available VM */
-    if ((mem_start_brk = (char *)malloc(MAX_HEAP)) == NULL) {
-	fprintf(stderr, "mem_init_vm: malloc error\n");
+    char *reserve;
+    uintptr_t start;
+    size_t len;
+
+    /* reserve the address space we will use to model the available VM
+       straight from the system, so that the heap never depends on libc's
+       malloc, which this package may be standing in for.  nothing is
+       committed yet; mem_sbrk makes it accessible as the heap grows. */
+    len = MAX_HEAP + HEAP_COMMIT;
+    reserve = (char *)mmap(NULL, len, PROT_NONE,
+			   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (reserve == MAP_FAILED) {
+	fprintf(stderr, "mem_init_vm: mmap error\n");
 	exit(1);
     }
 
+    /* align the heap to the commit size, which is also the huge page
+       size, and hand the slack on either side back */
+    start = ((uintptr_t)reserve + HEAP_COMMIT - 1) & ~(uintptr_t)(HEAP_COMMIT - 1);
+    mem_start_brk = (char *)start;
+    if (mem_start_brk > reserve)
+	munmap(reserve, mem_start_brk - reserve);
+    munmap(mem_start_brk + MAX_HEAP, reserve + len - (mem_start_brk + MAX_HEAP));
+#if USE_HUGEPAGES
+    /* only a hint; the heap works the same without huge pages */
+    madvise(mem_start_brk, MAX_HEAP, MADV_HUGEPAGE);
+#endif
+
     mem_max_addr = mem_start_brk + MAX_HEAP;  /* max legal heap address */
     mem_brk = mem_start_brk;                  /* heap is empty initially */
+    mem_fresh_brk = mem_start_brk;            /* and all of it is zero */
+    mem_commit_brk = mem_start_brk;           /* and none of it is mapped */
 }
 
 /* 
@@ -39,7 +72,7 @@ void mem_init(void)
  */
 void mem_deinit(void)
 {
-    free(mem_start_brk);
+    munmap(mem_start_brk, MAX_HEAP);
 }
 
 /*
@@ -48,26 +81,157 @@ void mem_deinit(void)
 void mem_reset_brk()
 {
     mem_brk = mem_start_brk;
+    mem_map_peak = 0;
 }
 
 /* 
  * mem_sbrk - simple model of the sbrk function. Extends the heap 
- *    by incr bytes and returns the start address of the new area. In
- *    this model, the heap cannot be shrunk.
+ *    by incr bytes and returns the start address of the new area. A
+ *    negative incr shrinks the heap, and the whole pages it gives up are
+ *    returned to the system.
  */
 void *mem_sbrk(intptr_t incr) 
 {
     char *old_brk = mem_brk;
 
-    if ( (incr < 0) || ((mem_brk + incr) > mem_max_addr)) {
+    if (incr < 0) {
+	if (-incr > mem_brk - mem_start_brk) {
+	    errno = EINVAL;
+	    fprintf(stderr, "ERROR: mem_sbrk failed. Heap would be negative...\n");
+	    return (void *)-1;
+	}
+	mem_brk += incr;
+	mem_release(mem_brk, -incr);
+	return (void *)old_brk;
+    }
+    if (incr > mem_max_addr - mem_brk || mem_commit(mem_brk + incr) < 0) {
 	errno = ENOMEM;
 	fprintf(stderr, "ERROR: mem_sbrk failed. Ran out of memory...\n");
 	return (void *)-1;
     }
     mem_brk += incr;
+    if (mem_brk > mem_fresh_brk)
+	mem_fresh_brk = mem_brk;
     return (void *)old_brk;
 }
 
+/*
+ * mem_commit - makes the heap accessible up to at least end, a whole
+ *    commit unit at a time. Returns 0 on success and -1 on failure.
+ */
+static int mem_commit(char *end)
+{
+    char *new_commit;
+
+    if (end <= mem_commit_brk)
+	return 0;
+    new_commit = mem_start_brk + ((end - mem_start_brk + HEAP_COMMIT - 1) &
+				  ~(uintptr_t)(HEAP_COMMIT - 1));
+    if (new_commit > mem_max_addr)
+	new_commit = mem_max_addr;
+    if (mprotect(mem_commit_brk, new_commit - mem_commit_brk,
+		 PROT_READ | PROT_WRITE) < 0)
+	return -1;
+    mem_commit_brk = new_commit;
+    return 0;
+}
+
+/*
+ * mem_release - tells the system that the size bytes at addr inside the
+ *    heap are unused, so the whole pages among them can be reclaimed. They
+ *    read as zero when next touched. Returns 0 on success and -1 on
+ *    failure.
+ */
+int mem_release(void *addr, size_t size)
+{
+    uintptr_t lo, hi, pagesize;
+
+    pagesize = (uintptr_t)getpagesize();
+    lo = ((uintptr_t)addr + pagesize - 1) & ~(pagesize - 1);
+    hi = ((uintptr_t)addr + size) & ~(pagesize - 1);
+    if (lo >= hi)
+	return 0;
+    return madvise((void *)lo, hi - lo, MADV_DONTNEED);
+}
+
+/*
+ * mem_map - maps size bytes of zeroed memory outside the heap, for blocks
+ *    too large to be worth carving from it. Returns the start address of
+ *    the new area, or (void *)-1 on failure.
+ */
+void *mem_map(size_t size)
+{
+    void *addr;
+
+    addr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED) {
+	errno = ENOMEM;
+	fprintf(stderr, "ERROR: mem_map failed. Ran out of memory...\n");
+	return (void *)-1;
+    }
+    mem_map_count(0, size);
+    return addr;
+}
+
+/*
+ * mem_remap - resizes an area returned by mem_map from oldsize to newsize
+ *    bytes, moving it if needed, without copying its contents. Returns the
+ *    new start address of the area, or (void *)-1 on failure, in which
+ *    case the area is left untouched.
+ */
+void *mem_remap(void *addr, size_t oldsize, size_t newsize)
+{
+    void *newaddr;
+
+    newaddr = mremap(addr, oldsize, newsize, MREMAP_MAYMOVE);
+    if (newaddr == MAP_FAILED) {
+	errno = ENOMEM;
+	return (void *)-1;
+    }
+    mem_map_count(oldsize, newsize);
+    return newaddr;
+}
+
+/*
+ * mem_unmap - returns an area of size bytes returned by mem_map or
+ *    mem_remap to the system. Returns 0 on success and -1 on failure.
+ */
+int mem_unmap(void *addr, size_t size)
+{
+    if (munmap(addr, size) < 0)
+	return -1;
+    mem_map_count(size, 0);
+    return 0;
+}
+
+/*
+ * mem_map_count - account for a mapped area changing from oldsize to
+ *    newsize bytes. Areas are mapped from several threads at once, so the
+ *    counts are updated atomically.
+ */
+static void mem_map_count(size_t oldsize, size_t newsize)
+{
+    size_t bytes, peak;
+
+    bytes = __atomic_add_fetch(&mem_map_bytes, newsize - oldsize,
+			       __ATOMIC_RELAXED);
+    peak = __atomic_load_n(&mem_map_peak, __ATOMIC_RELAXED);
+    while (bytes > peak &&
+	   !__atomic_compare_exchange_n(&mem_map_peak, &peak, bytes, 1,
+					__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+	;
+}
+
+/*
+ * mem_mapsize - returns the most bytes that areas from mem_map have
+ *    held at once since mem_reset_brk
+ */
+size_t mem_mapsize()
+{
+    return __atomic_load_n(&mem_map_peak, __ATOMIC_RELAXED);
+}
+
 /*
  * mem_heap_lo - return address of the first heap byte
  */
@@ -76,6 +240,15 @@ void *mem_heap_lo()
     return (void *)mem_start_brk;
 }
 
+/*
+ * mem_heap_fresh - return address of the first byte that mem_sbrk has never
+ *    handed out since mem_init. It and every byte above it read as zero.
+ */
+void *mem_heap_fresh()
+{
+    return (void *)mem_fresh_brk;
+}
+
 /* 
  * mem_heap_hi - return address of last heap byte
  */
@@ -92,6 +265,14 @@ size_t mem_heapsize()
     return (size_t)(mem_brk - mem_start_brk);
 }
 
+/*
+ * mem_maxsize() - returns the largest size in bytes the heap can grow to
+ */
+size_t mem_maxsize()
+{
+    return (size_t)(mem_max_addr - mem_start_brk);
+}
+
 /*
  * mem_pagesize() - returns the page size of the system
  */
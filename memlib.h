@@ -1,8 +1,15 @@
 void mem_init(void);               
 void mem_deinit(void);
 void *mem_sbrk(intptr_t incr);
+void *mem_map(size_t size);
+void *mem_remap(void *addr, size_t oldsize, size_t newsize);
+int mem_unmap(void *addr, size_t size);
+int mem_release(void *addr, size_t size);
 void mem_reset_brk(void); 
 void *mem_heap_lo(void);
 void *mem_heap_hi(void);
+void *mem_heap_fresh(void);
 size_t mem_heapsize(void);
+size_t mem_mapsize(void);
+size_t mem_maxsize(void);
 size_t mem_pagesize(void);
@@ -1,24 +1,28 @@
 /* 
  * Simple, 32-bit and 64-bit clean allocator based on an implicit free list,
  * first fit placement, and boundary tag coalescing, as described in the
- * CS:APP3e text.  Blocks are aligned to double-word boundaries.  This
- * yields 8-byte aligned blocks on a 32-bit processor, and 16-byte aligned
- * blocks on a 64-bit processor.  However, 16-byte alignment is stricter
- * than necessary; the assignment only requires 8-byte alignment.  The
- * minimum block size is four words.
+ * CS:APP3e text.  Blocks are aligned to 16 bytes, the alignment of
+ * max_align_t on common 64-bit platforms, rather than just the 8 bytes the
+ * assignment requires, so the allocator can stand in for the C library's.
+ * The minimum block size is four words.
  *
- * This allocator uses the size of a pointer, e.g., sizeof(void *), to
- * define the size of a word.  This allocator also uses the standard
- * type uintptr_t to define unsigned integers that are the same size
- * as a pointer, i.e., sizeof(uintptr_t) == sizeof(void *).
+ * This allocator uses 4-byte words for headers and footers, whatever the
+ * size of a pointer, and a free block on a segregated list links to its
+ * neighbors by 32-bit offsets from the start of the heap.  So the minimum
+ * block is 16 bytes, a heap block is smaller than 4 GB, and the heap
+ * itself is at most 64 GB.
  */
 
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <math.h>
 
+#include <sys/mman.h>
+
 #include "memlib.h"
 #include "mm.h"
 
@@ -45,112 +49,513 @@ struct pointer_data {
 	struct pointer_data *prev;
 };
 
+/*
+ * A free block on a segregated list links to its neighbors there by their
+ * offsets from the start of the heap, in ALIGNMENT-byte units.
+ */
+struct free_links {
+	uint32_t next;
+	uint32_t prev;
+};
+
+/*
+ * Free blocks of at least TREE_MIN_SIZE bytes are instead nodes of a
+ * red-black tree ordered by size, then address.
+ */
+struct tree_node {
+	struct	tree_node *child[2];	/* Smaller and larger blocks */
+	struct	tree_node *parent;
+	bool	red;
+};
+
+/*
+ * A region is a chain of chunks, each an allocated heap block that starts
+ * with a link to the previous chunk.  Objects are bumped out of the newest
+ * chunk and carry no header.  The region itself lives in its first chunk.
+ */
+struct region_chunk {
+	struct	region_chunk *prev;	/* Older chunk, or NULL */
+	char	*end;			/* End of this chunk's payload */
+};
+
+struct mm_region {
+	struct	region_chunk *chunk;	/* Newest chunk */
+	char	*cur;			/* Next free byte in the newest chunk */
+	char	*base;			/* First object in the first chunk */
+};
+
+/*
+ * A pool hands out slots of one size from region chunks.  Freed slots are
+ * kept on a list threaded through their "next" links; untouched slots are
+ * carved from the newest chunk only when that list is empty.
+ */
+struct mm_pool {
+	struct	pointer_data *free;	/* Freed slots */
+	struct	region_chunk *chunk;	/* Newest chunk */
+	char	*fresh;			/* Next untouched slot, if it fits */
+	size_t	size;			/* Slot size (bytes) */
+	size_t	align;			/* Slot alignment (bytes) */
+};
+
+/*
+ * A huge block's mapping starts with its links on the list of them and its
+ * length, which a heap block's header could not hold.  Only a block
+ * aligned more strictly than that has part of its mapping before them.
+ */
+struct huge_block {
+	struct	huge_block *next;
+	struct	huge_block *prev;
+	size_t	len;		/* Length of the whole mapping */
+	size_t	lead;		/* Bytes of the mapping before this header */
+};
+
 
 /* Basic constants and macros: */
-#define WSIZE      sizeof(void *) /* Word and header/footer size (bytes) */
+#define WSIZE      sizeof(uint32_t) /* Word and header/footer size (bytes) */
 #define DSIZE      (2 * WSIZE)    /* Doubleword size (bytes) */
 #define CHUNKSIZE  (1 << 12)      /* Extend heap by this amount (bytes) */
-#define ALIGNMENT  (sizeof(char) * 8)		  /* Byte alignment size (bytes) */
-#define NUM_BUCKETS (9)	/* Num of different free block sizes*/
+#define ALIGNMENT  (sizeof(char) * 16)		  /* Byte alignment size (bytes) */
+
+/*
+ * Two-level segregated fit (TLSF) index constants.  A free block's size
+ * selects a first-level class, the position of its highest set bit, and a
+ * second-level class, one of SL_INDEX_COUNT linear subdivisions of that
+ * power of two.  Sizes below SMALL_BLOCK_SIZE have an exact bin instead,
+ * one per multiple of ALIGNMENT.
+ */
+#define SL_INDEX_COUNT_LOG2 (4)
+#define SL_INDEX_COUNT	(1 << SL_INDEX_COUNT_LOG2)  /* Lists per power of 2 */
+#define ALIGN_SHIFT	(4)			    /* log2(ALIGNMENT) */
+#define FL_INDEX_SHIFT	(10)	/* Smaller blocks are kept in exact bins */
+#define FL_INDEX_MAX	(12)	/* Larger blocks are kept in the tree */
+#define FL_INDEX_COUNT	(FL_INDEX_MAX - FL_INDEX_SHIFT)
+#define SMALL_BLOCK_SIZE (1 << FL_INDEX_SHIFT)
+#define SMALL_BIN_COUNT	(SMALL_BLOCK_SIZE >> ALIGN_SHIFT)
+#define SMALL_MAP_WORDS	(SMALL_BIN_COUNT / 64)	/* Words of the bin bitmap */
+
+/* Smallest free block kept in the tree rather than a segregated list. */
+#define TREE_MIN_SIZE	((size_t)1 << FL_INDEX_MAX)
+
+/*
+ * The free lists of blocks from 2^(i + ORDER_MIN_SHIFT) bytes up to twice
+ * that hand out their blocks in config.order[i].  The first class starts
+ * at the smallest block, and the last ends at TREE_MIN_SIZE.
+ */
+#define ORDER_MIN_SHIFT	(FL_INDEX_MAX - MM_ORDER_CLASSES)
+#if ORDER_MIN_SHIFT != ALIGN_SHIFT
+#error "MM_ORDER_CLASSES must cover every block size below TREE_MIN_SIZE"
+#endif
+
+/*
+ * Every heap block is smaller than MAX_BLOCK_SIZE, so its size fits in a
+ * header word, and requests of HEAP_MAX_REQUEST bytes or more are never
+ * served from the heap.
+ */
+#define MAX_BLOCK_SIZE	(((size_t)1 << 32) - PAGESIZE)
+#define HEAP_MAX_REQUEST (MAX_BLOCK_SIZE / 2)
+
+/* Arena constants: */
+#define NUM_ARENAS (8)		/* Max independent heaps */
+#define PAGESIZE   (1 << 12)	/* Segment and page map granularity (bytes) */
+
+/* Slab constants: */
+#define SLAB_MAX_SIZE	 (512)	/* Largest request served from a slab run */
+#define SLAB_NUM_CLASSES (16)	/* Object sizes in slab_sizes */
+#define SLAB_ALIGN	 (ALIGNMENT)	/* Alignment of every slab object */
+
+/*
+ * Page map values: the owning arena's index plus one, and flags for slab
+ * pages and for free pages given back to the system.
+ */
+#define PAGE_ARENA_MASK (0x3f)
+#define PAGE_RELEASED	(0x40)
+#define PAGE_SLAB	(0x80)
+
+/* Region constants: */
+#define REGION_CHUNK	(4 * CHUNKSIZE)	/* Usual region chunk size (bytes) */
+
+/* Huge block constants: */
+#define MMAP_THRESHOLD	((size_t)1 << 25) /* Default mm_set_mmap_threshold */
+#define HUGE_HDR	(4 * DSIZE)	/* Links and length before a payload */
+
+/* Placement constants: */
+#define SPLIT_MIN	(2 * DSIZE) /* Default mm_set_split_threshold */
+#define PLACE_HIGH_SIZE	(1 << 10) /* Smallest block placed at a high end */
+#define FIT_SCAN	(1)	/* Default blocks scanned by find_fit */
+
+/* Heap growth constants, the defaults of mm_set_heap_growth: */
+#define GROWTH_MAX	((size_t)1 << 26) /* Largest growth step (bytes) */
+#define GROWTH_RATIO	(32)	/* A step is at most arena size / this */
+
+/* Thread-local cache constants: */
+#define TCACHE_NUM_BINS (SLAB_NUM_CLASSES) /* One bin per slab class */
+#define TCACHE_BIN_MAX	(32)	/* Max cached blocks per bin */
 
 
 #define MAX(x, y)  ((x) > (y) ? (x) : (y))  
+#define MIN(x, y)  ((x) < (y) ? (x) : (y))
 
-/* Pack a size and allocated bit into a word. */
+/*
+ * Pack a size and allocated bits into a word.  Sizes are multiples of a
+ * doubleword, and all but the prologue's of ALIGNMENT, so the low three
+ * bits are free for these.  Besides its own allocated bit, a header
+ * records whether the previous block is allocated, so only free blocks
+ * need a footer.  A free block's header may also record that
+ * the block is fresh: its payload has never been written, apart from its
+ * free list links or tree node and its footer, so it reads as zero.  The
+ * same bit of an allocated block's header records that mm_realloc has
+ * grown the block and has not shrunk it since.
+ */
 #define PACK(size, alloc)  ((size) | (alloc))
+#define PREV_ALLOC	   (0x2)
+#define FRESH		   (0x4)
+#define GROWN		   (0x4)
 
 /* Read and write a word at address p. */
-#define GET(p)       (*(uintptr_t *)(p))
-#define PUT(p, val)  (*(uintptr_t *)(p) = (val))
+#define GET(p)       (*(uint32_t *)(p))
+#define PUT(p, val)  (*(uint32_t *)(p) = (val))
 
 /* Read the size and allocated fields from address p. */
-#define GET_SIZE(p)   (GET(p) & ~(ALIGNMENT - 1))
+#define GET_SIZE(p)   (GET(p) & ~(DSIZE - 1))
 #define GET_ALLOC(p)  (GET(p) & 0x1)
+#define GET_PREV_ALLOC(p)  (GET(p) & PREV_ALLOC)
+#define GET_FRESH(p)  (GET(p) & FRESH)
+#define GET_GROWN(p)  (GET(p) & GROWN)
+
+/* Set or clear the previous-allocated bit of the header at address p. */
+#define SET_PREV_ALLOC(p)  PUT(p, GET(p) | PREV_ALLOC)
+#define CLR_PREV_ALLOC(p)  PUT(p, GET(p) & ~PREV_ALLOC)
+#define SET_GROWN(p)       PUT(p, GET(p) | GROWN)
+
+/*
+ * A block that mm_realloc grows twice in a row gets room to grow again
+ * without moving, an extra 1/2^REALLOC_RESERVE_SHIFT of its size.  It keeps
+ * that room only while its requests do not drop below the one it was
+ * reserved for.
+ */
+#define REALLOC_RESERVE_SHIFT (1)
+#define RESERVE(asize)  \
+	((asize) + (((asize) >> REALLOC_RESERVE_SHIFT) & ~(ALIGNMENT - 1)))
 
-/* Given block ptr bp, compute address of its header and footer. */
+/* Given block ptr bp, compute address of its header and, if free, footer. */
 #define HDRP(bp)  ((char *)(bp) - WSIZE)
 #define FTRP(bp)  ((char *)(bp) + GET_SIZE(HDRP(bp)) - DSIZE)
 
-/* Given block ptr bp, compute address of next and previous blocks. */
+/* Convert between a free block's address and its offset link. */
+#define LINK(bp)     ((uint32_t)(((char *)(bp) - heap_lo) / ALIGNMENT))
+#define LINKP(link)  ((void *)(heap_lo + (size_t)(link) * ALIGNMENT))
+
+/* Given address p inside the heap, compute the index of its page. */
+#define PAGE_INDEX(p)  \
+	(((uintptr_t)(p) / PAGESIZE) - ((uintptr_t)mem_heap_lo() / PAGESIZE))
+
+/* Given address p, test whether it lies outside the heap in a huge block. */
+#define IS_HUGE(p)  (PAGE_INDEX(p) >= page_map_size)
+
+/* Given address p inside the heap, test for and find its slab run. */
+#define IS_SLAB(p)  (PAGE_GET(PAGE_INDEX(p)) & PAGE_SLAB)
+#define RUN_OF(p)   ((struct slab_run *)((uintptr_t)(p) & ~(PAGESIZE - 1)))
+
+/*
+ * Given block ptr bp, compute address of next and previous blocks.  The
+ * previous block can only be found if it is free.
+ */
 #define NEXT_BLKP(bp)  ((char *)(bp) + GET_SIZE(((char *)(bp) - WSIZE)))
 #define PREV_BLKP(bp)  ((char *)(bp) - GET_SIZE(((char *)(bp) - DSIZE)))
 
+/*
+ * A slab run is one page holding objects of a single size class, with this
+ * header at its start.  Objects carry no header or footer: free ones are
+ * threaded through "free", and "fresh" bumps through those never handed
+ * out.  Runs with free objects are on their arena's list for their class.
+ * A run is the page-aligned payload of an allocated heap block, so an
+ * empty run is simply freed back into its arena.
+ */
+struct slab_run {
+	struct	slab_run *next;	/* Partial run list links */
+	struct	slab_run *prev;
+	void	*free;		/* Free list of returned objects */
+	char	*fresh;		/* First object never handed out */
+	int	class;		/* Index into slab_sizes */
+	int	nfree;		/* Free objects, including fresh ones */
+	int	nobjs;		/* Objects in the run */
+};
+
+/*
+ * A run's block is exactly one page long, so the next block's header is the
+ * last word of the page and runs can be adjacent.
+ */
+#define SLAB_RUN_SIZE	(PAGESIZE - WSIZE)
+#define SLAB_RUN_HDR \
+	((sizeof(struct slab_run) + (SLAB_ALIGN - 1)) & ~(SLAB_ALIGN - 1))
+
+/* Object sizes of the slab classes, all multiples of SLAB_ALIGN. */
+static const int slab_sizes[SLAB_NUM_CLASSES] = {
+	16, 32, 48, 64, 80, 96, 112, 128,
+	160, 192, 224, 256, 320, 384, 448, 512
+};
+
+/*
+ * An arena is an independent heap with its own segregated free lists and
+ * lock.  It is made of one or more segments, each a contiguous run of
+ * mem_sbrk memory with its own prologue and epilogue.  A segment other than
+ * the first starts on a PAGESIZE boundary, so every page belongs to at most
+ * one arena.  Blocks held in a thread cache stay marked as
+ * allocated, so no arena sees them until they are flushed.
+ */
+struct arena {
+	pthread_mutex_t lock;
+	/* First block of each free list, or 0, and bitmaps of non-empty ones */
+	uint32_t small_heads[SMALL_BIN_COUNT];
+	uint64_t small_bitmap[SMALL_MAP_WORDS];
+	uint32_t heads[FL_INDEX_COUNT][SL_INDEX_COUNT];
+	uint64_t fl_bitmap;
+	uint32_t sl_bitmap[FL_INDEX_COUNT];
+	struct	tree_node *tree_root;	/* Tree of large free blocks */
+	char	*seg_end;	/* End of the last segment, after its epilogue */
+	size_t	heap_size;	/* Bytes of all segments */
+	size_t	grow;		/* Next growth step, before the caps */
+	size_t	freed;		/* Bytes ever freed into the arena */
+	size_t	grow_limit;	/* "freed" beyond which growth starts over */
+	unsigned epoch;		/* heap_epoch this arena was initialized in */
+	/* Dummy heads of the partial slab run lists */
+	struct	slab_run runs[SLAB_NUM_CLASSES];
+};
+
 /* Global variables: */
-static char	*heap_listp; /* Pointer to first block */  
-static struct	pointer_data *dummy_head; /* Pointer to dummy head list*/
+static struct arena arenas[NUM_ARENAS];
+static unsigned arena_next;	/* Round-robin arena assignment counter */
+static __thread struct arena *thread_arena; /* Arena of the calling thread */
+
+/* 
+ * Maps each page of the heap to its owning arena's index plus one, or 0 if
+ * no arena owns it.  Pages holding a slab run also have PAGE_SLAB set,
+ * and pages inside free blocks that mm_trim gave back have PAGE_RELEASED
+ * set until anything is written to them again.  The lock serializes
+ * mem_sbrk and changes to page ownership; the flags of an arena's pages
+ * are changed under the arena's lock.  mm_free reads the map without any
+ * lock, so every access to it is atomic, and a flag is changed without
+ * disturbing the rest of its byte.
+ */
+static unsigned char *page_map;
+static size_t	page_map_size;	/* Number of pages the map can describe */
+static size_t	page_map_hi;	/* Number of entries that may be non-zero */
+static pthread_mutex_t sbrk_lock = PTHREAD_MUTEX_INITIALIZER;
+
+#define PAGE_GET(page)  __atomic_load_n(&page_map[page], __ATOMIC_RELAXED)
+#define PAGE_PUT(page, val)  \
+	__atomic_store_n(&page_map[page], (val), __ATOMIC_RELAXED)
+#define PAGE_SET_FLAG(page, flag)  \
+	__atomic_fetch_or(&page_map[page], (flag), __ATOMIC_RELAXED)
+#define PAGE_CLR_FLAG(page, flag)  \
+	__atomic_fetch_and(&page_map[page], (unsigned char)~(flag), \
+	    __ATOMIC_RELAXED)
+
+static unsigned heap_epoch; /* Bumped by mm_init, invalidates old state */
+static char	*heap_lo;   /* First heap byte, the base of free list links */
+
+/*
+ * Requests of at least mmap_threshold bytes get a mapping of their own
+ * from mem_map, outside the heap.  The list of them lets mm_init unmap
+ * them, and the lock protects it.
+ */
+static size_t	mmap_threshold = MMAP_THRESHOLD;
+static struct	huge_block huge_list = { &huge_list, &huge_list, 0, 0 };
+static pthread_mutex_t huge_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * An arena that keeps running out of memory grows by ever larger steps, up
+ * to growth_max bytes and never more than its size divided by
+ * growth_ratio.  Once more has been freed into it since an extension than
+ * that extension added, its demand is met by reuse, and the steps start
+ * over from CHUNKSIZE.
+ */
+static size_t	growth_max = GROWTH_MAX;
+static size_t	growth_ratio = GROWTH_RATIO;
+
+/* A free block is split if at least split_min bytes would be left over. */
+static size_t	split_min = SPLIT_MIN;
+
+/*
+ * The free list orders and fit scan, as set by mm_set_config.  The exact
+ * bins below SMALL_BLOCK_SIZE are LIFO, so the block freed last is reused
+ * first, and the other lists are FIFO.
+ */
+static struct mm_config config = {
+	{ MM_ORDER_LIFO, MM_ORDER_LIFO, MM_ORDER_LIFO, MM_ORDER_LIFO,
+	  MM_ORDER_LIFO, MM_ORDER_LIFO, MM_ORDER_FIFO, MM_ORDER_FIFO },
+	FIT_SCAN
+};
+
+/* The order of the free list that a free block of "size" bytes joins. */
+#define ORDER_OF(size)  (config.order[fls_size(size) - ORDER_MIN_SHIFT])
+
+/* Per-thread cache of recently freed blocks, one LIFO bin per bucket. */
+struct tcache {
+	struct pointer_data *bins[TCACHE_NUM_BINS]; /* Singly linked by next */
+	int	counts[TCACHE_NUM_BINS];
+	unsigned epoch;	/* heap_epoch the cached blocks belong to */
+	bool	registered; /* Thread exit destructor installed */
+};
+
+static __thread struct tcache tcache;
+static pthread_key_t tcache_key;
+static pthread_once_t tcache_key_once = PTHREAD_ONCE_INIT;
 
 /* Function prototypes for internal helper routines: */
-static void *coalesce(void *bp);
-static void *extend_heap(size_t words);
-static void *find_fit(size_t asize);
-static void place(void *bp, size_t asize);
+static void *coalesce(struct arena *arena, void *bp);
+static void *extend_heap(struct arena *arena, size_t words);
+static void *extend_top(struct arena *arena, size_t asize);
+static void *skip_top(struct arena *arena, void *bp);
+static void *find_fit(struct arena *arena, size_t asize);
+static void *list_fit(void *first, size_t asize, unsigned limit);
+static void *small_search(struct arena *arena, size_t asize);
+static void *place(struct arena *arena, void *bp, size_t asize);
+static void *heap_malloc(struct arena *arena, size_t asize, bool *fresh);
+static void *heap_malloc_aligned(struct arena *arena, size_t size,
+    size_t align);
+static size_t aligned_lead(void *bp, size_t align);
+static void heap_free(struct arena *arena, void *bp);
+static size_t heap_malloc_batch(struct arena *arena, size_t asize, size_t n,
+    void **out);
+static int ptr_compare(const void *a, const void *b);
+static void *heap_realloc(struct arena *arena, void *bp, size_t asize);
+static void resize_block(struct arena *arena, void *bp, size_t csize,
+    size_t asize);
+
+/* Function prototypes for region routines: */
+static struct region_chunk *region_chunk(size_t size,
+    struct region_chunk *prev);
+static void region_release(struct region_chunk *chunk,
+    struct region_chunk *last);
+
+/* Function prototypes for huge block routines: */
+static void *huge_malloc(size_t size);
+static void *huge_malloc_aligned(size_t size, size_t align);
+static void huge_free(void *bp);
+static void *huge_realloc(void *bp, size_t size);
+static void huge_link(struct huge_block *huge);
+
+/* Function prototypes for arena routines: */
+static int arena_init(struct arena *arena);
+static struct arena *arena_lock(void);
+static struct arena *arena_of(void *bp);
+static void page_map_set(char *lo, char *end, unsigned char value);
+static void page_map_reuse(char *lo, char *end);
+
+/* Function prototypes for heap trimming routines: */
+static bool trim_top(struct arena *arena, size_t pad);
+static bool release_tree(struct tree_node *node);
+
+/* Function prototypes for slab routines: */
+static int slab_class(size_t size);
+static void *slab_alloc(struct arena *arena, int class);
+static void slab_free(struct arena *arena, void *bp);
+
+/* Function prototypes for thread cache routines: */
+static void tcache_check_epoch(void);
+static void tcache_put(int bin, void *bp);
+static void tcache_flush_bin(int bin, int keep);
+static void tcache_key_init(void);
+static void tcache_destroy(void *arg);
 
 /* Function prototypes for heap consistency checker routines: */
 static void checkblock(void *bp);
-static void check_freelist(bool verbose);
+static void checkrun(struct slab_run *run);
+static void check_freelist(struct arena *arena, bool verbose);
 static void checkheap(bool verbose, bool checkfreelist);
 static void printblock(void *bp); 
 
 /* Helper functions*/
-static int round_next_pow2(int size);
-static int get_next_pow2_second(int size);
-static void insert_freeblock(void *bp);
-static void remove_freeblock(void *bp);
-static void insert_freelist(void *bp,  void *target);
+static int fls_size(size_t size);
+static void mapping_insert(size_t size, int *fli, int *sli);
+static bool mapping_search(size_t size, int *fli, int *sli);
+static void insert_freeblock(struct arena *arena, void *bp);
+static void remove_freeblock(struct arena *arena, void *bp);
+static void insert_freelist(void *bp, uint32_t *head, enum mm_order order);
+
+/* Function prototypes for free block tree routines: */
+static bool tree_less(struct tree_node *a, struct tree_node *b);
+static void tree_insert(struct arena *arena, struct tree_node *node);
+static void tree_remove(struct arena *arena, struct tree_node *node);
+static void tree_replace(struct arena *arena, struct tree_node *old,
+    struct tree_node *node);
+static void tree_rotate(struct arena *arena, struct tree_node *node, int dir);
+static struct tree_node *tree_search(struct arena *arena, size_t asize);
+static int check_tree(struct tree_node *node, struct tree_node *parent);
 
 
+/*
+ * Requires:
+ *   "a" and "b" point to pointers.
+ *
+ * Effects:
+ *   Order two pointers by address, for qsort.
+ */
 static int
-round_next_pow2(int size)
+ptr_compare(const void *a, const void *b)
 {
-	if (size <= 32) {
-		return (32);
-	}
-	if (size <= 64) {
-		return (64);
-	}
-	if (size <= 128) {
-		return (128);
-	}
-	if (size <= 256) {
-		return (256);
-	}
-	if (size <= 512) {
-		return (512);
-	}
-	
-	return (size);
+	uintptr_t pa, pb;
+
+	pa = (uintptr_t)*(void * const *)a;
+	pb = (uintptr_t)*(void * const *)b;
+
+	return ((pa > pb) - (pa < pb));
 }
 
-static int 
-get_next_pow2_second(int size) 
+/*
+ * Requires:
+ *   "size" is not zero.
+ *
+ * Effects:
+ *   Returns the index of the most significant set bit of "size".
+ */
+static int
+fls_size(size_t size)
 {
-	if (size <= 32) {
-		return (0);
-	}
-	if (size <= 64) {
-		return (1);
-	}
-	if (size <= 128) {
-		return (2);
-	}
-	if (size <= 256) {
-		return (3);
-	}
-	if (size <= 512) {
-		return (4);
-	}
-	if (size <= 1024) {
-		return (5);
-	}
-	if (size <= 2048) {
-		return (6);
-	}
-	if (size <= 4096) {
-		return (7);
-	}
-	return (8);
+
+	return ((int)(sizeof(size_t) * 8) - 1 - __builtin_clzl(size));
+}
+
+/*
+ * Requires:
+ *   SMALL_BLOCK_SIZE <= "size" < 2^FL_INDEX_MAX.
+ *
+ * Effects:
+ *   Compute the first and second level indices of the free list that a
+ *   free block of "size" bytes belongs to.
+ */
+static void
+mapping_insert(size_t size, int *fli, int *sli)
+{
+	int fl;
+
+	fl = fls_size(size);
+	*sli = (int)(size >> (fl - SL_INDEX_COUNT_LOG2)) ^ SL_INDEX_COUNT;
+	*fli = fl - FL_INDEX_SHIFT;
 }
 
+/*
+ * Requires:
+ *   "size" is at least SMALL_BLOCK_SIZE.
+ *
+ * Effects:
+ *   Compute the indices of the first free list whose blocks are all at
+ *   least "size" bytes, by rounding "size" up to the next list boundary.
+ *   Returns false if "size" is too large for any free list.
+ */
+static bool
+mapping_search(size_t size, int *fli, int *sli)
+{
+
+	size += ((size_t)1 << (fls_size(size) - SL_INDEX_COUNT_LOG2)) - 1;
+	if (fls_size(size) >= FL_INDEX_MAX) {
+		return (false);
+	}
+	mapping_insert(size, fli, sli);
+
+	return (true);
+}
 
 /* 
  * Requires:
@@ -164,36 +569,35 @@ int
 mm_init(void) 
 {
 	
-	void *bp;
-	int i;
-	
-	/*creates the memory for the dummy heads, prologue & epilogue*/
-	if ((heap_listp = mem_sbrk((DSIZE * NUM_BUCKETS) + (WSIZE * 3))) == (void *)-1) {
-		return (-1);
+	/* Blocks cached by any thread and every arena belong to the old heap. */
+	heap_epoch++;
+
+	/* So do the huge blocks. */
+	while (huge_list.next != &huge_list) {
+		huge_free((char *)huge_list.next + HUGE_HDR);
 	}
-	
-	// Inits heads
-	dummy_head = (struct pointer_data *)mem_heap_lo();
-	for (i = 0; i < NUM_BUCKETS; i++) {
-		dummy_head[i].next = &(dummy_head[i]);
-		dummy_head[i].prev = &(dummy_head[i]);
-		
 
-	}	
-	
-	// Put prologue hdr, ftr, and epilogue hdr
-	PUT(heap_listp + (NUM_BUCKETS * DSIZE) , PACK(DSIZE, 1)); 
-	PUT(heap_listp + (NUM_BUCKETS * DSIZE) + (1 * WSIZE), PACK(DSIZE, 1));
-	PUT(heap_listp + (NUM_BUCKETS * DSIZE) + (2* WSIZE), PACK(0, 1));  
-	//Aligns the heap pointer between prologue hdr & ftr
-	heap_listp += (NUM_BUCKETS * DSIZE) + (1 * WSIZE);
-
-	/* Extend the empty heap with a free block of CHUNKSIZE bytes. */
-	if ((bp = extend_heap(CHUNKSIZE / WSIZE)) == NULL) {
+	/* Free list links can only reach 2^32 units into the heap. */
+	if (mem_maxsize() > ((size_t)1 << 32) * ALIGNMENT) {
 		return (-1);
 	}
-	
-	return (0);
+	heap_lo = mem_heap_lo();
+
+	/* Map the page map once, sized for the largest heap memlib allows. */
+	if (page_map == NULL) {
+		page_map_size = PAGE_INDEX(heap_lo + mem_maxsize() - 1) + 1;
+		page_map = mmap(NULL, page_map_size, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (page_map == MAP_FAILED) {
+			page_map = NULL;
+			return (-1);
+		}
+	}
+	memset(page_map, 0, page_map_hi);
+	page_map_hi = 0;
+
+	/* Arena 0 is set up eagerly; the others on first use. */
+	return (arena_init(&arenas[0]));
 }
 
 /* 
@@ -209,8 +613,9 @@ void *
 mm_malloc(size_t size) 
 {
 	size_t asize;      /* Adjusted block size */
-	size_t extendsize; /* Amount to extend heap if no fit */
-	void *bp;
+	struct arena *arena;
+	struct pointer_data *bp;
+	int class;
 
 
 
@@ -218,298 +623,2167 @@ mm_malloc(size_t size)
 	if (size == 0){
 		return (NULL);
 	}
-		
 
-	/* Adjust block size to include overhead and alignment reqs. */
-	if (size <= DSIZE) {
-		asize = 2 * DSIZE;
-	} else if (size < 512) { // Small padding for small blocks
-		asize = round_next_pow2(size);
-		asize = (ALIGNMENT * ((asize + (ALIGNMENT - 1)) / ALIGNMENT)) + DSIZE;
-	}// Note, must be 4 words to holds hdrs & ftrs
-	else {
-		asize = (ALIGNMENT * ((size + (ALIGNMENT - 1)) / ALIGNMENT)) + DSIZE;
+	/* Small requests come from slab runs, through this thread's cache. */
+	if (size <= SLAB_MAX_SIZE) {
+		class = slab_class(size);
+		tcache_check_epoch();
+		if ((bp = tcache.bins[class]) != NULL) {
+			tcache.bins[class] = bp->next;
+			tcache.counts[class]--;
+			return (bp);
+		}
+		if ((arena = arena_lock()) == NULL) {
+			return (NULL);
+		}
+		bp = slab_alloc(arena, class);
+		pthread_mutex_unlock(&arena->lock);
+		return (bp);
 	}
 
-	/* Search the free list for a fit. */
-	if ((bp = find_fit(asize)) != NULL) {
-	
-		place(bp, asize);
-		return (bp);
+	/* Huge requests bypass the heap. */
+	if (size >= mmap_threshold) {
+		return (huge_malloc(size));
 	}
 
-	/* No fit found.  Get more memory and place the block. */
-	extendsize = MAX(asize, CHUNKSIZE);
-	if ((bp = extend_heap(extendsize / WSIZE)) == NULL) {
+	/* Adjust block size to include the header and alignment reqs. */
+	asize = ALIGNMENT * ((size + WSIZE + (ALIGNMENT - 1)) / ALIGNMENT);
+
+	if ((arena = arena_lock()) == NULL) {
 		return (NULL);
 	}
-
-	place(bp, asize);
+	bp = heap_malloc(arena, asize, NULL);
+	pthread_mutex_unlock(&arena->lock);
 
 	return (bp);
 } 
 
-/* 
+/*
  * Requires:
- *   "bp" is either the address of an allocated block or NULL.
+ *   None.
  *
  * Effects:
- *   Free a block.
+ *   Allocate a zeroed block with room for "nmemb" elements of "size" bytes
+ *   each, unless that is zero bytes.  Memory the heap has never handed out
+ *   and huge mappings are already zero, so a block carved from a fresh
+ *   free block only has its old links and footer cleared.  Returns the
+ *   address of this block if the allocation was successful and NULL
+ *   otherwise.
  */
-void
-mm_free(void *bp)
+void *
+mm_calloc(size_t nmemb, size_t size)
 {
-	size_t size;
-	
-	
-	/* Ignore spurious requests. */
+	struct arena *arena;
+	size_t asize, bytes;
+	bool fresh;
+	char *bp;
+
+	if (nmemb != 0 && size > SIZE_MAX / nmemb) {
+		return (NULL);
+	}
+	bytes = nmemb * size;
+	if (bytes <= SLAB_MAX_SIZE) {
+		if ((bp = mm_malloc(bytes)) != NULL) {
+			memset(bp, 0, bytes);
+		}
+		return (bp);
+	}
+	if (bytes >= mmap_threshold) {
+		return (huge_malloc(bytes));
+	}
+
+	/* Adjust block size to include the header and alignment reqs. */
+	asize = ALIGNMENT * ((bytes + WSIZE + (ALIGNMENT - 1)) / ALIGNMENT);
+	if ((arena = arena_lock()) == NULL) {
+		return (NULL);
+	}
+	bp = heap_malloc(arena, asize, &fresh);
+	pthread_mutex_unlock(&arena->lock);
 	if (bp == NULL) {
-		return;
+		return (NULL);
 	}
-			
-	/* Free and coalesce the block. */
-	size = GET_SIZE(HDRP(bp));
-	PUT(HDRP(bp), PACK(size, 0));
-	PUT(FTRP(bp), PACK(size, 0));
 
-	coalesce(bp);
+	if (fresh) {
+		memset(bp, 0, sizeof(struct tree_node));
+		PUT(FTRP(bp), 0);
+	} else {
+		memset(bp, 0, bytes);
+	}
 
+	return (bp);
 }
 
 /*
  * Requires:
- *   "ptr" is either the address of an allocated block or NULL.
+ *   None.
  *
  * Effects:
- *   Reallocates the block "ptr" to a block with at least "size" bytes of
- *   payload, unless "size" is zero.  If "size" is zero, frees the block
- *   "ptr" and returns NULL.  If the block "ptr" is already a block with at
- *   least "size" bytes of payload, then "ptr" may optionally be returned.
- *   Otherwise, a new block is allocated and the contents of the old block
- *   "ptr" are copied to that new block.  Returns the address of this new
- *   block if the allocation was successful and NULL otherwise.
+ *   Allocate a block with at least "size" bytes of payload that starts at a
+ *   multiple of "alignment", unless "size" is zero.  "alignment" must be a
+ *   power of two.  Up to PAGESIZE, the block is carved out of a larger free
+ *   block, whose leading and trailing slack are freed again.  A stricter
+ *   alignment, or a request that mm_malloc would map as a huge block, gets
+ *   a huge block of its own.  Either can be passed to mm_free and
+ *   mm_realloc.  Returns the address of this block if the allocation was
+ *   successful and NULL otherwise.
  */
 void *
-mm_realloc(void *ptr, size_t size)
+mm_memalign(size_t alignment, size_t size)
 {
-	size_t oldsize, asize, freeblock_size, splitblock_size;
-	void *newptr;
-
+	struct arena *arena;
+	void *bp;
 
-	/* If size == 0 then this is just free, and we return NULL. */
-	if (size == 0) {
-		mm_free(ptr);
+	if (size == 0 || alignment == 0 ||
+	    (alignment & (alignment - 1)) != 0) {
 		return (NULL);
 	}
 
-	/* If oldptr is NULL, then this is just malloc. */
-	if (ptr == NULL) {
+	// Every block is aligned to ALIGNMENT.
+	if (alignment <= ALIGNMENT) {
 		return (mm_malloc(size));
 	}
 
-	/* Adjust block size to include overhead and alignment reqs. */
-	if (size <= DSIZE) {
-		asize = 2 * DSIZE;
-	} // Note, must be 4 words to holds hdrs & ftrs
-	else {
-		asize = (ALIGNMENT * ((size + (ALIGNMENT - 1)) / ALIGNMENT)) + DSIZE;
+	// The threshold is never above HEAP_MAX_REQUEST.
+	if (alignment > PAGESIZE || size >= mmap_threshold) {
+		return (huge_malloc_aligned(size, alignment));
 	}
-
-	/* If size <= old size, return original block*/
-	if (asize <= GET_SIZE(HDRP(ptr)) - DSIZE) {
-		return (ptr);
+	size = ALIGNMENT * ((size + (ALIGNMENT - 1)) / ALIGNMENT);
+	if ((arena = arena_lock()) == NULL) {
+		return (NULL);
 	}
+	bp = heap_malloc_aligned(arena, size, alignment);
+	pthread_mutex_unlock(&arena->lock);
 
+	return (bp);
+}
 
-	/* If next block free & size <= old size + size of free block, 
-	return original block. */
-	if (!GET_ALLOC(HDRP(NEXT_BLKP(ptr))) && 
-	    asize <= GET_SIZE(HDRP(ptr)) + GET_SIZE(HDRP(NEXT_BLKP(ptr))) - DSIZE) {
-		oldsize = GET_SIZE(HDRP(ptr));
-		freeblock_size = GET_SIZE(HDRP(NEXT_BLKP(ptr)));
+/*
+ * Requires:
+ *   None.
+ *
+ * Effects:
+ *   The C11 spelling of mm_memalign.
+ */
+void *
+mm_aligned_alloc(size_t alignment, size_t size)
+{
 
-		//check to see if remainder large enough to split, add to free list 
-		if (oldsize + freeblock_size >= asize + (2 * DSIZE)) {
-			// remove next free block from free list
-			remove_freeblock(NEXT_BLKP(ptr));
-			// update allocated block size
-			PUT(HDRP(ptr), PACK(asize, 1));
-			PUT(FTRP(ptr), PACK(asize, 1));
-			// update split block size
-			splitblock_size = oldsize + freeblock_size - asize;
-			PUT(HDRP(NEXT_BLKP(ptr)), PACK(splitblock_size, 0));
-			PUT(FTRP(NEXT_BLKP(ptr)), PACK(splitblock_size, 0));
-			// add new split block to free list
-			insert_freeblock(NEXT_BLKP(ptr));
+	return (mm_memalign(alignment, size));
+}
 
-		} else { // Don't split, update size and remove from free list
-			remove_freeblock(NEXT_BLKP(ptr));
-			PUT(HDRP(ptr), PACK(oldsize + freeblock_size, 1));
-			PUT(FTRP(ptr), PACK(oldsize + freeblock_size, 1));
-		}
-		return (ptr);
-	}
+/* 
+ * Requires:
+ *   "bp" is either the address of an allocated block or NULL.
+ *
+ * Effects:
+ *   Free a block.
+ */
+void
+mm_free(void *bp)
+{
+	struct arena *arena;
 	
-	/* Otherwise, malloc enough space plus extra and copy*/
 	
-	asize = 2 * asize;
-	newptr = mm_malloc(asize);
-
-	/* If realloc() fails, the original block is left untouched.  */
-	if (newptr == NULL) {
-		return (NULL);
+	/* Ignore spurious requests. */
+	if (bp == NULL) {
+		return;
 	}
-		
-	/* Copy just the old data, not the old header and footer. */
-	oldsize = GET_SIZE(HDRP(ptr)) - DSIZE;
-	
-	memcpy(newptr, ptr, oldsize);
 
-	/* Free the old block. */
-	mm_free(ptr);
+	if (IS_HUGE(bp)) {
+		huge_free(bp);
+		return;
+	}
 
+	/* Slab objects go to this thread's cache, still allocated. */
+	if (IS_SLAB(bp)) {
+		tcache_put(RUN_OF(bp)->class, bp);
+		return;
+	}
 
-	// get rid of warnings
-	(void)freeblock_size;
-	(void)splitblock_size;
-	
-	return (newptr);
+	arena = arena_of(bp);
+	pthread_mutex_lock(&arena->lock);
+	heap_free(arena, bp);
+	pthread_mutex_unlock(&arena->lock);
 }
 
-
-/*
- * The following routines are internal helper routines.
- */
-
 /*
  * Requires:
- *   "bp" is the address of a newly freed block.
+ *   "bp" is either NULL or the address of an allocated block, and "size"
+ *   is the size it was last requested with by mm_malloc or mm_realloc.
  *
  * Effects:
- *   Perform boundary tag coalescing. Returns the address of the coalesced
- *   block after inserting it into the freelist.
+ *   Free a block, like mm_free.  A slab object's class is found from
+ *   "size", so the header of its run is not read.
+ */
+void
+mm_free_sized(void *bp, size_t size)
+{
+
+	// A block shrunk by mm_realloc may be small without being a slab
+	// object, so the page map still decides.
+	if (bp != NULL && size != 0 && size <= SLAB_MAX_SIZE && !IS_HUGE(bp) &&
+	    IS_SLAB(bp)) {
+		tcache_put(slab_class(size), bp);
+		return;
+	}
+	mm_free(bp);
+}
+
+/*
+ * Requires:
+ *   "bp" is either the address of an allocated block or NULL.
+ *
+ * Effects:
+ *   Returns the number of bytes of payload the block "bp" really has, all
+ *   of which may be used, or zero if "bp" is NULL.
+ */
+size_t
+mm_usable_size(void *bp)
+{
+	struct huge_block *huge;
+
+	if (bp == NULL) {
+		return (0);
+	}
+	if (IS_HUGE(bp)) {
+		huge = (struct huge_block *)((char *)bp - HUGE_HDR);
+		return (huge->len - huge->lead - HUGE_HDR);
+	}
+	if (IS_SLAB(bp)) {
+		return (slab_sizes[RUN_OF(bp)->class]);
+	}
+
+	return (GET_SIZE(HDRP(bp)) - WSIZE);
+}
+
+/*
+ * Requires:
+ *   None.
+ *
+ * Effects:
+ *   Returns 1 if "ptr" lies inside the heap or is the address of a huge
+ *   block that is still mapped, and 0 otherwise.  Unlike the other
+ *   routines, this accepts any pointer, so a caller can check one before
+ *   trusting it.
+ */
+int
+mm_owns(void *ptr)
+{
+	struct huge_block *huge;
+	int owned;
+
+	if (!IS_HUGE(ptr)) {
+		return ((char *)ptr >= (char *)mem_heap_lo() &&
+		    (char *)ptr <= (char *)mem_heap_hi());
+	}
+	owned = 0;
+	pthread_mutex_lock(&huge_lock);
+	for (huge = huge_list.next; huge != &huge_list; huge = huge->next) {
+		if ((char *)huge + HUGE_HDR == ptr) {
+			owned = 1;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&huge_lock);
+
+	return (owned);
+}
+
+/*
+ * Requires:
+ *   "out" has room for "n" pointers.
+ *
+ * Effects:
+ *   Allocate "n" blocks with at least "size" bytes of payload each and
+ *   store their addresses in "out".  Heap blocks are carved side by side
+ *   out of a single free block, and slab objects are taken under a single
+ *   lock.  Returns the number of blocks allocated, which is less than "n"
+ *   only if memory ran out.
+ */
+size_t
+mm_malloc_batch(size_t size, size_t n, void **out)
+{
+	struct arena *arena;
+	size_t asize, i;
+	int class;
+
+	if (size == 0 || n == 0) {
+		return (0);
+	}
+
+	if (size <= SLAB_MAX_SIZE) {
+		class = slab_class(size);
+		if ((arena = arena_lock()) == NULL) {
+			return (0);
+		}
+		for (i = 0; i < n; i++) {
+			if ((out[i] = slab_alloc(arena, class)) == NULL) {
+				break;
+			}
+		}
+		pthread_mutex_unlock(&arena->lock);
+		return (i);
+	}
+
+	/* Adjust block size to include the header and alignment reqs. */
+	asize = ALIGNMENT * ((size + WSIZE + (ALIGNMENT - 1)) / ALIGNMENT);
+
+	// Huge blocks and batches too large to carve are allocated singly.
+	i = 0;
+	if (size < mmap_threshold && asize <= mmap_threshold / n) {
+		if ((arena = arena_lock()) == NULL) {
+			return (0);
+		}
+		i = heap_malloc_batch(arena, asize, n, out);
+		pthread_mutex_unlock(&arena->lock);
+	}
+	for (; i < n; i++) {
+		if ((out[i] = mm_malloc(size)) == NULL) {
+			break;
+		}
+	}
+
+	return (i);
+}
+
+/*
+ * Requires:
+ *   Each of the "n" pointers in "ptrs" is either the address of an
+ *   allocated block or NULL.
+ *
+ * Effects:
+ *   Free the "n" blocks in "ptrs", which is sorted by address in the
+ *   process.  Runs of adjacent heap blocks are merged before they are
+ *   coalesced with their neighbors, and each arena's lock is held across
+ *   the blocks that it owns.
+ */
+void
+mm_free_batch(void **ptrs, size_t n)
+{
+	struct arena *arena, *locked;
+	size_t i, j, size;
+	char *bp;
+
+	qsort(ptrs, n, sizeof(*ptrs), ptr_compare);
+	locked = NULL;
+	for (i = 0; i < n; i = j) {
+		bp = ptrs[i];
+		j = i + 1;
+		if (bp == NULL) {
+			continue;
+		}
+		if (IS_HUGE(bp)) {
+			huge_free(bp);
+			continue;
+		}
+		arena = arena_of(bp);
+		if (arena != locked) {
+			if (locked != NULL) {
+				pthread_mutex_unlock(&locked->lock);
+			}
+			pthread_mutex_lock(&arena->lock);
+			locked = arena;
+		}
+		if (IS_SLAB(bp)) {
+			slab_free(arena, bp);
+			continue;
+		}
+
+		// Merge the run of blocks that follow each other in the heap.
+		size = GET_SIZE(HDRP(bp));
+		for (; j < n && ptrs[j] == bp + size &&
+		    size + GET_SIZE(HDRP(ptrs[j])) <= MAX_BLOCK_SIZE; j++) {
+			size += GET_SIZE(HDRP(ptrs[j]));
+		}
+		PUT(HDRP(bp), PACK(size, GET_PREV_ALLOC(HDRP(bp))));
+		PUT(FTRP(bp), PACK(size, 0));
+		arena->freed += size;
+		coalesce(arena, bp);
+	}
+	if (locked != NULL) {
+		pthread_mutex_unlock(&locked->lock);
+	}
+}
+
+/*
+ * Requires:
+ *   None.
+ *
+ * Effects:
+ *   Return every block in the calling thread's cache to the segregated
+ *   free lists of the arenas that own them.
+ */
+void
+mm_tcache_flush(void)
+{
+	int i;
+
+	tcache_check_epoch();
+	for (i = 0; i < TCACHE_NUM_BINS; i++) {
+		tcache_flush_bin(i, 0);
+	}
+}
+
+/*
+ * Requires:
+ *   None.
+ *
+ * Effects:
+ *   Give free memory back to the system.  The calling thread's cache is
+ *   flushed, the free block at the top of the heap shrinks to "pad" bytes
+ *   (rounded up to a page boundary) and the whole pages inside large free
+ *   blocks are released.  Returns 1 if any memory was given back and 0
+ *   otherwise.
+ */
+int
+mm_trim(size_t pad)
+{
+	struct arena *arena;
+	bool trimmed;
+	int i;
+
+	mm_tcache_flush();
+	trimmed = false;
+	for (i = 0; i < NUM_ARENAS; i++) {
+		arena = &arenas[i];
+		pthread_mutex_lock(&arena->lock);
+		if (arena->epoch == heap_epoch) {
+			trimmed |= trim_top(arena, pad);
+			trimmed |= release_tree(arena->tree_root);
+		}
+		pthread_mutex_unlock(&arena->lock);
+	}
+
+	return (trimmed);
+}
+
+/*
+ * Requires:
+ *   None.
+ *
+ * Effects:
+ *   Set the request size at and above which blocks get a mapping of their
+ *   own instead of coming from the heap.  Requests small enough for a slab
+ *   run never do, and requests too large for a heap block always do.
+ */
+void
+mm_set_mmap_threshold(size_t threshold)
+{
+
+	mmap_threshold = MIN(threshold, HEAP_MAX_REQUEST);
+}
+
+/*
+ * Requires:
+ *   "out" is not NULL.
+ *
+ * Effects:
+ *   Store the current free list configuration in "*out".
+ */
+void
+mm_get_config(struct mm_config *out)
+{
+
+	*out = config;
+}
+
+/*
+ * Requires:
+ *   "cfg" is not NULL.
+ *
+ * Effects:
+ *   Set the order in which the free lists of each power of two of block
+ *   sizes hand out their blocks, and how many blocks find_fit scans for
+ *   the best fit in the list a request maps to before it settles for the
+ *   first list whose blocks all fit.  An order applies to blocks freed
+ *   from then on.  Returns 0 if successful and -1 if an order is invalid.
+ */
+int
+mm_set_config(const struct mm_config *cfg)
+{
+	int i;
+
+	for (i = 0; i < MM_ORDER_CLASSES; i++) {
+		if ((unsigned)cfg->order[i] > MM_ORDER_ADDRESS) {
+			return (-1);
+		}
+	}
+	config = *cfg;
+
+	return (0);
+}
+
+/*
+ * Requires:
+ *   None.
+ *
+ * Effects:
+ *   Set the fewest bytes that must be left over before a free block is
+ *   split to serve a smaller request.  Below this, the request gets the
+ *   whole block.  No threshold is smaller than the minimum block size.
+ */
+void
+mm_set_split_threshold(size_t threshold)
+{
+
+	split_min = MAX(ALIGNMENT * ((threshold + (ALIGNMENT - 1)) / ALIGNMENT),
+	    2 * DSIZE);
+}
+
+/*
+ * Requires:
+ *   None.
+ *
+ * Effects:
+ *   Set how far an arena with no free top block grows when it must extend
+ *   the heap.  The growth starts at CHUNKSIZE and doubles with each such
+ *   extension, but it is at most "max" bytes and at most the arena's size
+ *   divided by "ratio", so a small heap stays tight.  A "max" of zero
+ *   keeps every extension to CHUNKSIZE or the request, whichever is
+ *   larger.  The growth starts over when more has been freed into the
+ *   arena since its last extension than that extension added, and after
+ *   mm_trim.
+ */
+void
+mm_set_heap_growth(size_t max, size_t ratio)
+{
+
+	growth_max = max;
+	growth_ratio = MAX(ratio, 1);
+}
+
+/*
+ * Requires:
+ *   "ptr" is either the address of an allocated block or NULL.
+ *
+ * Effects:
+ *   Reallocates the block "ptr" to a block with at least "size" bytes of
+ *   payload, unless "size" is zero.  If "size" is zero, frees the block
+ *   "ptr" and returns NULL.  If the block "ptr" is already a block with at
+ *   least "size" bytes of payload, then "ptr" may optionally be returned.
+ *   Otherwise, a new block is allocated and the contents of the old block
+ *   "ptr" are copied to that new block.  Returns the address of this new
+ *   block if the allocation was successful and NULL otherwise.
+ */
+void *
+mm_realloc(void *ptr, size_t size)
+{
+	size_t oldsize, asize;
+	struct arena *arena;
+	void *newptr;
+	bool grown;
+
+
+	/* If size == 0 then this is just free, and we return NULL. */
+	if (size == 0) {
+		mm_free(ptr);
+		return (NULL);
+	}
+
+	/* If oldptr is NULL, then this is just malloc. */
+	if (ptr == NULL) {
+		return (mm_malloc(size));
+	}
+
+	if (IS_HUGE(ptr)) {
+		return (huge_realloc(ptr, size));
+	}
+
+	/* Adjust block size to include the header and alignment reqs. */
+	if (size <= DSIZE + WSIZE) {
+		asize = 2 * DSIZE;
+	} // Note, must be 4 words to hold a free block's hdr, links & ftr
+	else {
+		asize = ALIGNMENT * ((size + WSIZE + (ALIGNMENT - 1)) / ALIGNMENT);
+	}
+
+	/* A slab object is reused if its class is large enough, else moved. */
+	if (IS_SLAB(ptr)) {
+		oldsize = slab_sizes[RUN_OF(ptr)->class];
+		if (size <= oldsize) {
+			return (ptr);
+		}
+		grown = false;
+	} else {
+		/* Resize the block in place, or move it within its neighbors. */
+		if (size < HEAP_MAX_REQUEST) {
+			arena = arena_of(ptr);
+			pthread_mutex_lock(&arena->lock);
+			newptr = heap_realloc(arena, ptr, asize);
+			pthread_mutex_unlock(&arena->lock);
+			if (newptr != NULL) {
+				return (newptr);
+			}
+		}
+		/* Copy just the old data, not the old header. */
+		oldsize = GET_SIZE(HDRP(ptr)) - WSIZE;
+		grown = GET_GROWN(HDRP(ptr));
+	}
+
+	/*
+	 * Otherwise, malloc a new block and copy.  A heap block remembers
+	 * that it grew, and one that grows again gets room to spare.
+	 */
+	if (size <= SLAB_MAX_SIZE || size >= mmap_threshold) {
+		newptr = mm_malloc(size);
+	} else if ((arena = arena_lock()) != NULL) {
+		newptr = heap_malloc(arena, grown ? RESERVE(asize) : asize,
+		    NULL);
+		if (newptr != NULL) {
+			SET_GROWN(HDRP(newptr));
+		}
+		pthread_mutex_unlock(&arena->lock);
+	} else {
+		newptr = NULL;
+	}
+
+	/* If realloc() fails, the original block is left untouched.  */
+	if (newptr == NULL) {
+		return (NULL);
+	}
+
+	memcpy(newptr, ptr, MIN(oldsize, size));
+
+	/* Free the old block. */
+	mm_free(ptr);
+
+	return (newptr);
+}
+
+
+/*
+ * Requires:
+ *   None.
+ *
+ * Effects:
+ *   Create an empty region.  Objects allocated from a region are freed all
+ *   at once by mm_region_reset or mm_region_destroy, never by mm_free.  A
+ *   region must only be used by one thread at a time.  Returns the region
+ *   if successful and NULL otherwise.
+ */
+struct mm_region *
+mm_region_create(void)
+{
+	struct region_chunk *chunk;
+	struct mm_region *region;
+
+	if ((chunk = region_chunk(REGION_CHUNK, NULL)) == NULL) {
+		return (NULL);
+	}
+	region = (struct mm_region *)(chunk + 1);
+	region->chunk = chunk;
+	region->base = (char *)chunk + ALIGNMENT * ((sizeof(*chunk) +
+	    sizeof(*region) + (ALIGNMENT - 1)) / ALIGNMENT);
+	region->cur = region->base;
+
+	return (region);
+}
+
+/*
+ * Requires:
+ *   "region" is a region.
+ *
+ * Effects:
+ *   Allocate an object with at least "size" bytes from "region", unless
+ *   "size" is zero or too large for a heap block.  It is bumped out of the
+ *   newest chunk, which is replaced when full.  Returns the address of
+ *   this object if the allocation was successful and NULL otherwise.
+ */
+void *
+mm_region_alloc(struct mm_region *region, size_t size)
+{
+	struct region_chunk *chunk;
+	char *bp;
+
+	// Rounding a request too large for any chunk could wrap around.
+	if (size == 0 || size >= HEAP_MAX_REQUEST) {
+		return (NULL);
+	}
+	size = ALIGNMENT * ((size + (ALIGNMENT - 1)) / ALIGNMENT);
+
+	if ((size_t)(region->chunk->end - region->cur) < size) {
+		chunk = region_chunk(MAX(REGION_CHUNK,
+		    size + sizeof(struct region_chunk)), region->chunk);
+		if (chunk == NULL) {
+			return (NULL);
+		}
+		region->chunk = chunk;
+		region->cur = (char *)(chunk + 1);
+	}
+	bp = region->cur;
+	region->cur += size;
+
+	return (bp);
+}
+
+/*
+ * Requires:
+ *   "region" is a region.
+ *
+ * Effects:
+ *   Free every object allocated from "region", leaving it empty.  All
+ *   chunks but the first are freed back into the heap.
+ */
+void
+mm_region_reset(struct mm_region *region)
+{
+	struct region_chunk *first;
+
+	first = (struct region_chunk *)region - 1;
+	region_release(region->chunk, first);
+	region->chunk = first;
+	region->cur = region->base;
+}
+
+/*
+ * Requires:
+ *   "region" is a region.
+ *
+ * Effects:
+ *   Free every object allocated from "region" and the region itself.
+ */
+void
+mm_region_destroy(struct mm_region *region)
+{
+
+	region_release(region->chunk, NULL);
+}
+
+/*
+ * Requires:
+ *   None.
+ *
+ * Effects:
+ *   Create a pool of objects with at least "obj_size" bytes each, aligned
+ *   to "align", or to ALIGNMENT if "align" is zero.  "align" must be a
+ *   power of two no larger than PAGESIZE.  Objects are allocated and freed
+ *   by mm_pool_alloc and mm_pool_free, never by mm_malloc and mm_free.  A
+ *   pool must only be used by one thread at a time.  Returns the pool if
+ *   successful and NULL otherwise.
+ */
+struct mm_pool *
+mm_pool_create(size_t obj_size, size_t align)
+{
+	struct region_chunk *chunk;
+	struct mm_pool *pool;
+
+	if (align == 0) {
+		align = ALIGNMENT;
+	}
+	if (obj_size == 0 || obj_size > SIZE_MAX / 2 ||
+	    (align & (align - 1)) != 0 || align > PAGESIZE) {
+		return (NULL);
+	}
+	align = MAX(align, ALIGNMENT);
+
+	if ((chunk = region_chunk(REGION_CHUNK, NULL)) == NULL) {
+		return (NULL);
+	}
+	pool = (struct mm_pool *)(chunk + 1);
+	pool->free = NULL;
+	pool->chunk = chunk;
+	pool->fresh = (char *)(pool + 1);
+	pool->size = MAX(obj_size, sizeof(struct pointer_data));
+	pool->size = align * ((pool->size + (align - 1)) / align);
+	pool->align = align;
+
+	return (pool);
+}
+
+/*
+ * Requires:
+ *   "pool" is a pool.
+ *
+ * Effects:
+ *   Allocate an object from "pool".  Returns the address of this object if
+ *   the allocation was successful and NULL otherwise.
+ */
+void *
+mm_pool_alloc(struct mm_pool *pool)
+{
+	struct pointer_data *bp;
+	struct region_chunk *chunk;
+	uintptr_t slot;
+
+	if ((bp = pool->free) != NULL) {
+		pool->free = bp->next;
+		return (bp);
+	}
+
+	slot = ((uintptr_t)pool->fresh + (pool->align - 1)) &
+	    ~(uintptr_t)(pool->align - 1);
+	if (slot + pool->size > (uintptr_t)pool->chunk->end) {
+		chunk = region_chunk(MAX(REGION_CHUNK, sizeof(struct
+		    region_chunk) + pool->align + pool->size), pool->chunk);
+		if (chunk == NULL) {
+			return (NULL);
+		}
+		pool->chunk = chunk;
+		slot = ((uintptr_t)(chunk + 1) + (pool->align - 1)) &
+		    ~(uintptr_t)(pool->align - 1);
+	}
+	pool->fresh = (char *)(slot + pool->size);
+
+	return ((void *)slot);
+}
+
+/*
+ * Requires:
+ *   "ptr" is NULL or was returned by mm_pool_alloc on "pool" and has not
+ *   since been freed.
+ *
+ * Effects:
+ *   Return the object "ptr" to "pool" for reuse.
+ */
+void
+mm_pool_free(struct mm_pool *pool, void *ptr)
+{
+	struct pointer_data *bp;
+
+	if (ptr == NULL) {
+		return;
+	}
+	bp = ptr;
+	bp->next = pool->free;
+	pool->free = bp;
+}
+
+/*
+ * Requires:
+ *   "pool" is a pool.
+ *
+ * Effects:
+ *   Free every object allocated from "pool" and the pool itself.
+ */
+void
+mm_pool_destroy(struct mm_pool *pool)
+{
+
+	region_release(pool->chunk, NULL);
+}
+
+/*
+ * The following routines are internal helper routines.
+ */
+
+/*
+ * Requires:
+ *   The lock of "arena" is held.
+ *
+ * Effects:
+ *   Allocate a block of "asize" bytes from "arena", extending the arena if
+ *   no fit is found.  Unless "fresh" is NULL, "*fresh" is set to whether
+ *   the block came from a fresh free block.  Returns the address of this
+ *   block if the allocation was successful and NULL otherwise.
+ */
+static void *
+heap_malloc(struct arena *arena, size_t asize, bool *fresh)
+{
+	void *bp;
+
+	/* Search the free list for a fit, or else use the wilderness. */
+	if ((bp = find_fit(arena, asize)) == NULL &&
+	    (bp = extend_top(arena, asize)) == NULL) {
+		return (NULL);
+	}
+	if (fresh != NULL) {
+		*fresh = GET_FRESH(HDRP(bp));
+	}
+
+	return (place(arena, bp, asize));
+}
+
+/*
+ * Requires:
+ *   The lock of "arena" is held, "align" is a power of two no smaller than
+ *   ALIGNMENT, and "size" is a multiple of ALIGNMENT.
+ *
+ * Effects:
+ *   Allocate a block from "arena" whose payload holds "size" bytes and
+ *   starts at a multiple of "align".  It is carved out of a free block
+ *   large enough for any alignment, and the leading and trailing slack
+ *   are freed again.  Returns the payload address if successful and NULL
+ *   otherwise.
+ */
+static void *
+heap_malloc_aligned(struct arena *arena, size_t size, size_t align)
+{
+	size_t asize, csize, lead, search;
+	char *bp, *abp;
+
+	asize = MAX(ALIGNMENT * ((size + WSIZE + (ALIGNMENT - 1)) / ALIGNMENT),
+	    2 * DSIZE);
+	search = asize + align + (2 * DSIZE);
+
+	// A block just large enough may happen to be suitably aligned.
+	if ((bp = find_fit(arena, asize)) == NULL ||
+	    aligned_lead(bp, align) + asize > GET_SIZE(HDRP(bp))) {
+		if ((bp = find_fit(arena, search)) == NULL &&
+		    (bp = extend_top(arena, search)) == NULL) {
+			return (NULL);
+		}
+	}
+	remove_freeblock(arena, bp);
+	csize = GET_SIZE(HDRP(bp));
+	lead = aligned_lead(bp, align);
+	abp = bp + lead;
+	if (lead != 0) {
+		PUT(HDRP(abp), PACK(csize - lead, 1));
+		PUT(HDRP(bp), PACK(lead, GET_PREV_ALLOC(HDRP(bp))));
+		PUT(FTRP(bp), PACK(lead, 0));
+		coalesce(arena, bp);
+	} else {
+		PUT(HDRP(abp), PACK(csize, 1 | GET_PREV_ALLOC(HDRP(bp))));
+	}
+
+	// Give back any trailing slack that holds a whole free block.
+	csize -= lead;
+	if (csize - asize >= 2 * DSIZE) {
+		PUT(HDRP(abp), PACK(asize, 1 | GET_PREV_ALLOC(HDRP(abp))));
+		bp = NEXT_BLKP(abp);
+		PUT(HDRP(bp), PACK(csize - asize, PREV_ALLOC));
+		PUT(FTRP(bp), PACK(csize - asize, 0));
+		coalesce(arena, bp);
+	} else {
+		SET_PREV_ALLOC(HDRP(NEXT_BLKP(abp)));
+	}
+	page_map_reuse(HDRP(abp), HDRP(NEXT_BLKP(abp)));
+
+	return (abp);
+}
+
+/*
+ * Requires:
+ *   "bp" is the address of a block and "align" is a power of two no
+ *   smaller than ALIGNMENT.
+ *
+ * Effects:
+ *   Returns the distance from "bp" to the first payload address in it that
+ *   is a multiple of "align" and leaves either no leading slack or enough
+ *   for a whole free block.
+ */
+static size_t
+aligned_lead(void *bp, size_t align)
+{
+	size_t lead;
+
+	lead = (align - ((uintptr_t)bp & (align - 1))) & (align - 1);
+	while (lead != 0 && lead < 2 * DSIZE) {
+		lead += align;
+	}
+
+	return (lead);
+}
+
+/*
+ * Requires:
+ *   The lock of "arena" is held and "bp" is the address of an allocated
+ *   block owned by "arena".
+ *
+ * Effects:
+ *   Free and coalesce the block "bp" into "arena".
+ */
+static void
+heap_free(struct arena *arena, void *bp)
+{
+	size_t size;
+
+	size = GET_SIZE(HDRP(bp));
+	PUT(HDRP(bp), PACK(size, GET_PREV_ALLOC(HDRP(bp))));
+	PUT(FTRP(bp), PACK(size, 0));
+	arena->freed += size;
+
+	coalesce(arena, bp);
+}
+
+/*
+ * Requires:
+ *   The lock of "arena" is held, "asize" is a valid block size and
+ *   "n" * "asize" does not overflow.
+ *
+ * Effects:
+ *   Allocate "n" blocks of "asize" bytes from "arena", carved in order out
+ *   of one free block, and store their addresses in "out".  The last
+ *   block's tail is split off as in mm_realloc.  Returns "n" if
+ *   successful and 0 otherwise.
+ */
+static size_t
+heap_malloc_batch(struct arena *arena, size_t asize, size_t n, void **out)
+{
+	size_t csize, i;
+	char *bp;
+
+	if ((bp = find_fit(arena, n * asize)) == NULL &&
+	    (bp = extend_top(arena, n * asize)) == NULL) {
+		return (0);
+	}
+	remove_freeblock(arena, bp);
+	csize = GET_SIZE(HDRP(bp));
+
+	for (i = 0; i < n - 1; i++) {
+		out[i] = bp;
+		PUT(HDRP(bp), PACK(asize, 1 | GET_PREV_ALLOC(HDRP(bp))));
+		page_map_reuse(HDRP(bp), HDRP(bp) + asize);
+		bp += asize;
+		PUT(HDRP(bp), PACK(0, PREV_ALLOC));
+	}
+	out[i] = bp;
+	resize_block(arena, bp, csize - (n - 1) * asize, asize);
+
+	return (n);
+}
+
+/*
+ * Requires:
+ *   The lock of "arena" is held, "bp" is the address of an allocated block
+ *   owned by "arena", and "asize" is a valid block size.
+ *
+ * Effects:
+ *   Resize the block "bp" to "asize" bytes without leaving its
+ *   neighborhood.  A shrinking block gives back its tail, which ends its
+ *   growth, unless it has grown and RESERVE of the request still covers
+ *   it.  A growing block absorbs the free block after it, extends the heap
+ *   if it is the last block of its arena, or else absorbs the free block
+ *   before it and moves its payload down.  If it has grown before, it
+ *   takes up to RESERVE bytes.  Returns the block's new address, or NULL
+ *   if it cannot be resized in place, in which case it is left untouched.
+ */
+static void *
+heap_realloc(struct arena *arena, void *bp, size_t asize)
+{
+	size_t oldsize, nsize, psize, target;
+	char *brk, *next, *prev;
+	bool top;
+
+	oldsize = GET_SIZE(HDRP(bp));
+	if (asize <= oldsize) {
+		if (!GET_GROWN(HDRP(bp)) || RESERVE(asize) < oldsize) {
+			resize_block(arena, bp, oldsize, asize);
+		}
+		return (bp);
+	}
+	target = GET_GROWN(HDRP(bp)) ? RESERVE(asize) : asize;
+
+	next = NEXT_BLKP(bp);
+	nsize = GET_ALLOC(HDRP(next)) ? 0 : GET_SIZE(HDRP(next));
+
+	// A block followed only by the epilogue at the break can grow there.
+	if (oldsize + nsize < asize &&
+	    GET_SIZE(HDRP(next + nsize)) == 0 && next + nsize == arena->seg_end) {
+		pthread_mutex_lock(&sbrk_lock);
+		brk = (char *)mem_heap_hi() + 1;
+		top = (brk == arena->seg_end);
+		pthread_mutex_unlock(&sbrk_lock);
+		// The extension merges with any free block before it.
+		if (top && extend_heap(arena, MAX(target - oldsize - nsize,
+		    2 * DSIZE) / WSIZE) == next) {
+			nsize = GET_SIZE(HDRP(next));
+		}
+	}
+
+	/* Grow forward into the free block after "bp". */
+	if (oldsize + nsize >= asize) {
+		remove_freeblock(arena, next);
+		resize_block(arena, bp, oldsize + nsize,
+		    MIN(oldsize + nsize, target));
+		SET_GROWN(HDRP(bp));
+		return (bp);
+	}
+
+	/* Grow backward into the free block before "bp", moving the data. */
+	psize = GET_PREV_ALLOC(HDRP(bp)) ? 0 : GET_SIZE(HDRP(PREV_BLKP(bp)));
+	if (psize + oldsize + nsize >= asize) {
+		prev = PREV_BLKP(bp);
+		remove_freeblock(arena, prev);
+		if (nsize != 0) {
+			remove_freeblock(arena, next);
+		}
+		memmove(prev, bp, oldsize - WSIZE);
+		resize_block(arena, prev, psize + oldsize + nsize,
+		    MIN(psize + oldsize + nsize, target));
+		SET_GROWN(HDRP(prev));
+		return (prev);
+	}
+
+	return (NULL);
+}
+
+/*
+ * Requires:
+ *   The lock of "arena" is held, "bp" is the address of an allocated block
+ *   of "arena" whose header has a valid previous-allocated bit, and the
+ *   "csize" bytes starting at its header are not on any free list.
+ *
+ * Effects:
+ *   Make "bp" an allocated block of "csize" bytes, then give back any tail
+ *   beyond "asize" bytes that can hold a free block.
+ */
+static void
+resize_block(struct arena *arena, void *bp, size_t csize, size_t asize)
+{
+	char *tail;
+
+	if (csize - asize >= 2 * DSIZE) {
+		PUT(HDRP(bp), PACK(asize, 1 | GET_PREV_ALLOC(HDRP(bp))));
+		tail = NEXT_BLKP(bp);
+		PUT(HDRP(tail), PACK(csize - asize, PREV_ALLOC));
+		PUT(FTRP(tail), PACK(csize - asize, 0));
+		coalesce(arena, tail);
+	} else {
+		PUT(HDRP(bp), PACK(csize, 1 | GET_PREV_ALLOC(HDRP(bp))));
+		SET_PREV_ALLOC(HDRP(NEXT_BLKP(bp)));
+	}
+	page_map_reuse(HDRP(bp), HDRP(NEXT_BLKP(bp)));
+}
+
+/*
+ * Requires:
+ *   None.
+ *
+ * Effects:
+ *   Empty the calling thread's cache if its blocks were cached before the
+ *   last call to mm_init, since they no longer belong to the heap.
+ */
+static void
+tcache_check_epoch(void)
+{
+
+	if (tcache.epoch != heap_epoch) {
+		memset(tcache.bins, 0, sizeof(tcache.bins));
+		memset(tcache.counts, 0, sizeof(tcache.counts));
+		tcache.epoch = heap_epoch;
+	}
+}
+
+/*
+ * Requires:
+ *   "bin" is a valid thread cache bin and "bp" is an allocated slab object
+ *   whose class is at least "bin".
+ *
+ * Effects:
+ *   Push the slab object "bp" onto the calling thread's cache bin "bin",
+ *   first flushing half of the bin if it is full.
+ */
+static void
+tcache_put(int bin, void *bp)
+{
+	struct pointer_data *node;
+
+	tcache_check_epoch();
+	if (!tcache.registered) {
+		pthread_once(&tcache_key_once, tcache_key_init);
+		pthread_setspecific(tcache_key, &tcache);
+		tcache.registered = true;
+	}
+	if (tcache.counts[bin] == TCACHE_BIN_MAX) {
+		tcache_flush_bin(bin, TCACHE_BIN_MAX / 2);
+	}
+	node = (struct pointer_data *)bp;
+	node->next = tcache.bins[bin];
+	tcache.bins[bin] = node;
+	tcache.counts[bin]++;
+}
+
+/*
+ * Requires:
+ *   "bin" is a valid thread cache bin.
+ *
+ * Effects:
+ *   Free blocks from the calling thread's cache bin back into their arenas
+ *   until only "keep" blocks remain.  An arena's lock is held across runs
+ *   of blocks that it owns.
+ */
+static void
+tcache_flush_bin(int bin, int keep)
+{
+	struct arena *arena, *locked;
+	struct pointer_data *bp;
+
+	locked = NULL;
+	while (tcache.counts[bin] > keep) {
+		bp = tcache.bins[bin];
+		tcache.bins[bin] = bp->next;
+		tcache.counts[bin]--;
+		arena = arena_of(bp);
+		if (arena != locked) {
+			if (locked != NULL) {
+				pthread_mutex_unlock(&locked->lock);
+			}
+			pthread_mutex_lock(&arena->lock);
+			locked = arena;
+		}
+		slab_free(arena, bp);
+	}
+	if (locked != NULL) {
+		pthread_mutex_unlock(&locked->lock);
+	}
+}
+
+/*
+ * Requires:
+ *   None.
+ *
+ * Effects:
+ *   Create the key whose destructor flushes a thread's cache on exit.
+ */
+static void
+tcache_key_init(void)
+{
+
+	pthread_key_create(&tcache_key, tcache_destroy);
+}
+
+/*
+ * Requires:
+ *   "arg" is the exiting thread's cache.
+ *
+ * Effects:
+ *   Flush the exiting thread's cache back into the arenas.
+ */
+static void
+tcache_destroy(void *arg)
+{
+
+	(void)arg;
+	mm_tcache_flush();
+}
+
+/*
+ * Requires:
+ *   "arena" is not in use by any other thread.
+ *
+ * Effects:
+ *   Empty the free lists of "arena" and give it a first segment of
+ *   CHUNKSIZE bytes.  Returns 0 if successful and -1 otherwise.
+ */
+static int
+arena_init(struct arena *arena)
+{
+	int i, j;
+
+	// Inits heads
+	for (i = 0; i < SMALL_BIN_COUNT; i++) {
+		arena->small_heads[i] = 0;
+	}
+	for (i = 0; i < SMALL_MAP_WORDS; i++) {
+		arena->small_bitmap[i] = 0;
+	}
+	for (i = 0; i < FL_INDEX_COUNT; i++) {
+		for (j = 0; j < SL_INDEX_COUNT; j++) {
+			arena->heads[i][j] = 0;
+		}
+		arena->sl_bitmap[i] = 0;
+	}
+	arena->fl_bitmap = 0;
+	arena->tree_root = NULL;
+	for (i = 0; i < SLAB_NUM_CLASSES; i++) {
+		arena->runs[i].next = &(arena->runs[i]);
+		arena->runs[i].prev = &(arena->runs[i]);
+	}
+	// Forces extend_heap to start a new segment.
+	arena->seg_end = NULL;
+	arena->heap_size = 0;
+	arena->grow = CHUNKSIZE;
+	arena->freed = 0;
+	arena->grow_limit = 0;
+
+	/* Extend the empty arena with a free block of CHUNKSIZE bytes. */
+	if (extend_heap(arena, CHUNKSIZE / WSIZE) == NULL) {
+		return (-1);
+	}
+	arena->epoch = heap_epoch;
+
+	return (0);
+}
+
+/*
+ * Requires:
+ *   None.
+ *
+ * Effects:
+ *   Lock and return the calling thread's arena, assigning one round-robin
+ *   on first use and initializing it if it is not part of the current
+ *   heap.  Returns NULL if the arena could not be initialized.
+ */
+static struct arena *
+arena_lock(void)
+{
+	struct arena *arena;
+	unsigned i;
+
+	if ((arena = thread_arena) == NULL) {
+		i = __atomic_fetch_add(&arena_next, 1, __ATOMIC_RELAXED);
+		arena = thread_arena = &arenas[i % NUM_ARENAS];
+	}
+	pthread_mutex_lock(&arena->lock);
+	if (arena->epoch != heap_epoch && arena_init(arena) == -1) {
+		pthread_mutex_unlock(&arena->lock);
+		return (NULL);
+	}
+
+	return (arena);
+}
+
+/*
+ * Requires:
+ *   "bp" is the address of a block inside the heap.
+ *
+ * Effects:
+ *   Returns the arena that owns the block "bp".
+ */
+static struct arena *
+arena_of(void *bp)
+{
+
+	return (&arenas[(PAGE_GET(PAGE_INDEX(bp)) & PAGE_ARENA_MASK) - 1]);
+}
+
+/*
+ * Requires:
+ *   "sbrk_lock" is held and [lo, end) lies inside the heap.
+ *
+ * Effects:
+ *   Record "value" in the page map for every page overlapping [lo, end).
+ */
+static void
+page_map_set(char *lo, char *end, unsigned char value)
+{
+	size_t page;
+
+	for (page = PAGE_INDEX(lo); page <= PAGE_INDEX(end - 1); page++) {
+		PAGE_PUT(page, value);
+	}
+	page_map_hi = MAX(page_map_hi, page);
+}
+
+/*
+ * The following routines give free memory back to the system.
+ */
+
+/*
+ * Requires:
+ *   The lock of "arena" is held.
+ *
+ * Effects:
+ *   If the last segment of "arena" ends at the break and its last block is
+ *   free, shrink that block to "pad" bytes and move the break down to the
+ *   page boundary after it.  If the break cannot move, the block is left
+ *   as it was.  Returns true if the heap shrank.
+ */
+static bool
+trim_top(struct arena *arena, size_t pad)
+{
+	size_t size, newsize;
+	char *brk, *bp, *end;
+
+	pthread_mutex_lock(&sbrk_lock);
+	brk = (char *)mem_heap_hi() + 1;
+	if (brk != arena->seg_end || GET_PREV_ALLOC(HDRP(brk))) {
+		pthread_mutex_unlock(&sbrk_lock);
+		return (false);
+	}
+
+	// The new break is page aligned, and the block either vanishes or
+	// stays large enough to be free.
+	bp = PREV_BLKP(brk);
+	size = GET_SIZE(HDRP(bp));
+	pad = (pad + (DSIZE - 1)) & ~(DSIZE - 1);
+	end = (char *)(((uintptr_t)HDRP(bp) + pad + WSIZE + (PAGESIZE - 1)) &
+	    ~(uintptr_t)(PAGESIZE - 1));
+	newsize = end - WSIZE - HDRP(bp);
+	if (newsize != 0 && newsize < 2 * DSIZE) {
+		newsize += PAGESIZE;
+		end += PAGESIZE;
+	}
+	if (newsize >= size) {
+		pthread_mutex_unlock(&sbrk_lock);
+		return (false);
+	}
+
+	remove_freeblock(arena, bp);
+	if (mem_sbrk(-(intptr_t)(size - newsize)) == (void *)-1) {
+		insert_freeblock(arena, bp);
+		pthread_mutex_unlock(&sbrk_lock);
+		return (false);
+	}
+	page_map_set(end, brk, 0);
+	arena->seg_end = end;
+	arena->heap_size -= size - newsize;
+	// Demand has fallen, so growth starts small again.
+	arena->grow = CHUNKSIZE;
+	pthread_mutex_unlock(&sbrk_lock);
+
+	if (newsize == 0) {
+		// The block's header becomes the new epilogue.
+		PUT(HDRP(bp), PACK(0, 1 | GET_PREV_ALLOC(HDRP(bp))));
+	} else {
+		PUT(HDRP(bp), PACK(newsize, GET_PREV_ALLOC(HDRP(bp))));
+		PUT(FTRP(bp), PACK(newsize, 0));
+		PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1));
+		insert_freeblock(arena, bp);
+	}
+
+	return (true);
+}
+
+/*
+ * Requires:
+ *   The lock of the arena owning the tree "node" is held.
+ *
+ * Effects:
+ *   Give back the whole pages inside each free block of the subtree
+ *   "node", past its tree node and before its footer, that are not already
+ *   released, and mark them released.  Returns true if any page was.
+ */
+static bool
+release_tree(struct tree_node *node)
+{
+	char *lo, *hi, *run;
+	bool released;
+
+	if (node == NULL) {
+		return (false);
+	}
+	released = release_tree(node->child[0]);
+	released |= release_tree(node->child[1]);
+
+	lo = (char *)(((uintptr_t)(node + 1) + (PAGESIZE - 1)) &
+	    ~(uintptr_t)(PAGESIZE - 1));
+	hi = (char *)((uintptr_t)FTRP(node) & ~(uintptr_t)(PAGESIZE - 1));
+	// Release each run of pages that are still held.
+	for (run = NULL; lo <= hi; lo += PAGESIZE) {
+		if (lo < hi && !(PAGE_GET(PAGE_INDEX(lo)) & PAGE_RELEASED)) {
+			PAGE_SET_FLAG(PAGE_INDEX(lo), PAGE_RELEASED);
+			if (run == NULL) {
+				run = lo;
+			}
+		} else if (run != NULL) {
+			mem_release(run, lo - run);
+			released = true;
+			run = NULL;
+		}
+	}
+
+	return (released);
+}
+
+/*
+ * The following routines implement the chunks of regions and pools.
+ */
+
+/*
+ * Requires:
+ *   "size" is at least the size of a chunk link.
+ *
+ * Effects:
+ *   Allocate a chunk with "size" bytes of payload from the calling
+ *   thread's arena, linked to "prev".  Returns the chunk if successful and
+ *   NULL otherwise.
+ */
+static struct region_chunk *
+region_chunk(size_t size, struct region_chunk *prev)
+{
+	struct region_chunk *chunk;
+	struct arena *arena;
+	size_t asize;
+
+	if (size >= HEAP_MAX_REQUEST || (arena = arena_lock()) == NULL) {
+		return (NULL);
+	}
+	asize = ALIGNMENT * ((size + WSIZE + (ALIGNMENT - 1)) / ALIGNMENT);
+	chunk = heap_malloc(arena, asize, NULL);
+	pthread_mutex_unlock(&arena->lock);
+	if (chunk == NULL) {
+		return (NULL);
+	}
+	chunk->prev = prev;
+	chunk->end = (char *)chunk + GET_SIZE(HDRP(chunk)) - WSIZE;
+
+	return (chunk);
+}
+
+/*
+ * Requires:
+ *   "last" is NULL or a chunk reached from "chunk" by following links.
+ *
+ * Effects:
+ *   Free the chunks from "chunk" back to, but not including, "last" into
+ *   the heap, where they coalesce with their free neighbors.
+ */
+static void
+region_release(struct region_chunk *chunk, struct region_chunk *last)
+{
+	struct region_chunk *prev;
+	struct arena *arena;
+
+	for (; chunk != last; chunk = prev) {
+		prev = chunk->prev;
+		arena = arena_of(chunk);
+		pthread_mutex_lock(&arena->lock);
+		heap_free(arena, chunk);
+		pthread_mutex_unlock(&arena->lock);
+	}
+}
+
+/*
+ * The following routines implement huge blocks, each in its own mapping.
+ */
+
+/*
+ * Requires:
+ *   None.
+ *
+ * Effects:
+ *   Map a huge block with at least "size" bytes of payload.  Returns the
+ *   address of this block if successful and NULL otherwise.
+ */
+static void *
+huge_malloc(size_t size)
+{
+	struct huge_block *huge;
+	size_t len;
+
+	len = (size + HUGE_HDR + (PAGESIZE - 1)) & ~(size_t)(PAGESIZE - 1);
+	if (len < size || (huge = mem_map(len)) == (void *)-1) {
+		return (NULL);
+	}
+	huge->len = len;
+	huge->lead = 0;
+	huge_link(huge);
+
+	return ((char *)huge + HUGE_HDR);
+}
+
+/*
+ * Requires:
+ *   "align" is a power of two.
+ *
+ * Effects:
+ *   Map a huge block with at least "size" bytes of payload that starts at
+ *   a multiple of "align".  The mapping is large enough to align the
+ *   payload wherever it lands, and the whole pages it does not need are
+ *   unmapped again.  Returns the address of this block if successful and
+ *   NULL otherwise.
+ */
+static void *
+huge_malloc_aligned(size_t size, size_t align)
+{
+	struct huge_block *huge;
+	size_t len;
+	char *map, *start, *end, *bp;
+
+	len = (size + HUGE_HDR + (PAGESIZE - 1)) & ~(size_t)(PAGESIZE - 1);
+	if (len < size || len + align < len ||
+	    (map = mem_map(len + align)) == (void *)-1) {
+		return (NULL);
+	}
+	bp = (char *)(((uintptr_t)map + HUGE_HDR + (align - 1)) &
+	    ~(uintptr_t)(align - 1));
+	start = (char *)((uintptr_t)(bp - HUGE_HDR) &
+	    ~(uintptr_t)(PAGESIZE - 1));
+	end = (char *)(((uintptr_t)bp + size + (PAGESIZE - 1)) &
+	    ~(uintptr_t)(PAGESIZE - 1));
+	if (start > map) {
+		mem_unmap(map, start - map);
+	}
+	if (end < map + len + align) {
+		mem_unmap(end, map + len + align - end);
+	}
+
+	huge = (struct huge_block *)(bp - HUGE_HDR);
+	huge->len = end - start;
+	huge->lead = (char *)huge - start;
+	huge_link(huge);
+
+	return (bp);
+}
+
+/*
+ * Requires:
+ *   "bp" is the address of a huge block.
+ *
+ * Effects:
+ *   Unmap the huge block "bp".
+ */
+static void
+huge_free(void *bp)
+{
+	struct huge_block *huge;
+
+	huge = (struct huge_block *)((char *)bp - HUGE_HDR);
+	pthread_mutex_lock(&huge_lock);
+	huge->prev->next = huge->next;
+	huge->next->prev = huge->prev;
+	pthread_mutex_unlock(&huge_lock);
+	mem_unmap((char *)huge - huge->lead, huge->len);
+}
+
+/*
+ * Requires:
+ *   "bp" is the address of a huge block and "size" is not zero.
+ *
+ * Effects:
+ *   Resize the huge block "bp" to hold "size" bytes by remapping it, so
+ *   its contents are never copied.  A block resized below the threshold
+ *   moves back into the heap instead.  Returns the block's new address if
+ *   successful and NULL otherwise, in which case "bp" is left untouched.
+ */
+static void *
+huge_realloc(void *bp, size_t size)
+{
+	struct huge_block *huge, *moved;
+	size_t lead, len, oldlen;
+	char *map;
+	void *newptr;
+
+	// An aligned block may be smaller than the threshold to begin with.
+	if (size < mmap_threshold) {
+		if ((newptr = mm_malloc(size)) == NULL) {
+			return (NULL);
+		}
+		memcpy(newptr, bp, MIN(size, mm_usable_size(bp)));
+		huge_free(bp);
+		return (newptr);
+	}
+
+	huge = (struct huge_block *)((char *)bp - HUGE_HDR);
+	oldlen = huge->len;
+	lead = huge->lead;
+	len = (size + lead + HUGE_HDR + (PAGESIZE - 1)) &
+	    ~(size_t)(PAGESIZE - 1);
+	if (len < size) {
+		return (NULL);
+	}
+	if (len == oldlen) {
+		return (bp);
+	}
+
+	// The links move with the mapping, so take the block off the list.
+	// A moved block keeps its offset into the mapping.
+	pthread_mutex_lock(&huge_lock);
+	huge->prev->next = huge->next;
+	huge->next->prev = huge->prev;
+	pthread_mutex_unlock(&huge_lock);
+	if ((map = mem_remap((char *)huge - lead, oldlen, len)) ==
+	    (void *)-1) {
+		huge_link(huge);
+		return (NULL);
+	}
+	moved = (struct huge_block *)(map + lead);
+	moved->len = len;
+	huge_link(moved);
+
+	return ((char *)moved + HUGE_HDR);
+}
+
+/*
+ * Requires:
+ *   "huge" is the start of a huge block's mapping that is not on the list.
+ *
+ * Effects:
+ *   Add the huge block to the list of them.
+ */
+static void
+huge_link(struct huge_block *huge)
+{
+
+	pthread_mutex_lock(&huge_lock);
+	huge->next = huge_list.next;
+	huge->prev = &huge_list;
+	huge_list.next->prev = huge;
+	huge_list.next = huge;
+	pthread_mutex_unlock(&huge_lock);
+}
+
+/*
+ * Requires:
+ *   The lock of the arena owning [lo, end) is held, and that memory is
+ *   being allocated or holds a free block's header, links or footer.
+ *
+ * Effects:
+ *   Clear the released flag of every page overlapping [lo, end).
+ */
+static void
+page_map_reuse(char *lo, char *end)
+{
+	size_t page;
+
+	for (page = PAGE_INDEX(lo); page <= PAGE_INDEX(end - 1); page++) {
+		// Most pages were never released; skip the atomic write.
+		if (PAGE_GET(page) & PAGE_RELEASED) {
+			PAGE_CLR_FLAG(page, PAGE_RELEASED);
+		}
+	}
+}
+
+/*
+ * The following routines implement the slab allocator for small objects.
+ */
+
+/*
+ * Requires:
+ *   0 < "size" <= SLAB_MAX_SIZE.
+ *
+ * Effects:
+ *   Returns the smallest slab class whose objects hold "size" bytes.
+ *   Classes are 16 bytes apart up to 128 bytes, then four per power of 2.
+ */
+static int
+slab_class(size_t size)
+{
+	int fl;
+
+	if (size <= 128) {
+		return ((int)((size + 15) >> 4) - 1);
+	}
+	fl = fls_size(size - 1);
+
+	return (8 + ((fl - 7) * 4) + (int)(((size - 1) >> (fl - 2)) & 3));
+}
+
+/*
+ * Requires:
+ *   The lock of "arena" is held.
+ *
+ * Effects:
+ *   Allocate an object of slab class "class" from "arena", starting a new
+ *   run if no run of that class has a free object.  Returns the object's
+ *   address if successful and NULL otherwise.
+ */
+static void *
+slab_alloc(struct arena *arena, int class)
+{
+	struct slab_run *head, *run;
+	void *bp;
+
+	head = &(arena->runs[class]);
+	if ((run = head->next) == head) {
+		if ((run = heap_malloc_aligned(arena, SLAB_RUN_SIZE,
+		    PAGESIZE)) == NULL) {
+			return (NULL);
+		}
+		PAGE_SET_FLAG(PAGE_INDEX(run), PAGE_SLAB);
+		run->class = class;
+		run->nobjs = (SLAB_RUN_SIZE - SLAB_RUN_HDR) / slab_sizes[class];
+		run->nfree = run->nobjs;
+		run->free = NULL;
+		run->fresh = (char *)run + SLAB_RUN_HDR;
+		run->next = head;
+		run->prev = head;
+		head->next = run;
+		head->prev = run;
+	}
+
+	// Prefer returned objects, which are more likely to be cached.
+	if (run->free != NULL) {
+		bp = run->free;
+		run->free = *(void **)bp;
+	} else {
+		bp = run->fresh;
+		run->fresh += slab_sizes[class];
+	}
+	// A full run leaves the list until an object is freed.
+	if (--run->nfree == 0) {
+		run->prev->next = run->next;
+		run->next->prev = run->prev;
+	}
+
+	return (bp);
+}
+
+/*
+ * Requires:
+ *   The lock of "arena" is held and "bp" is an allocated slab object of
+ *   "arena".
+ *
+ * Effects:
+ *   Free the slab object "bp".  A run that becomes empty is freed back into
+ *   the heap, unless it is the only run left for its class.
+ */
+static void
+slab_free(struct arena *arena, void *bp)
+{
+	struct slab_run *head, *run;
+
+	run = RUN_OF(bp);
+	*(void **)bp = run->free;
+	run->free = bp;
+
+	head = &(arena->runs[run->class]);
+	if (run->nfree++ == 0) {
+		// The run was full, so put it back on its class's list.
+		run->next = head->next;
+		run->prev = head;
+		head->next->prev = run;
+		head->next = run;
+	} else if (run->nfree == run->nobjs &&
+	    (head->next != run || run->next != head)) {
+		run->prev->next = run->next;
+		run->next->prev = run->prev;
+		PAGE_CLR_FLAG(PAGE_INDEX(run), PAGE_SLAB);
+		heap_free(arena, run);
+	}
+}
+
+/*
+ * Requires:
+ *   "bp" is the address of a newly freed block with a header and footer.
+ *
+ * Effects:
+ *   Perform boundary tag coalescing and clear the previous-allocated bit of
+ *   the following block. Returns the address of the coalesced block after
+ *   inserting it into the freelist.
  */
 static void *
-coalesce(void *bp) 
+coalesce(struct arena *arena, void *bp) 
 {
 	//printf("enter coalsce\n");
 	size_t size = GET_SIZE(HDRP(bp));
-	bool prev_alloc = GET_ALLOC(FTRP(PREV_BLKP(bp)));
+	bool prev_alloc = GET_PREV_ALLOC(HDRP(bp));
 	bool next_alloc = GET_ALLOC(HDRP(NEXT_BLKP(bp)));
 
-	
+	// A neighbor that would make the block too large for its header is
+	// left unmerged, as if it were allocated.
+	if (!prev_alloc &&
+	    size + GET_SIZE(HDRP(PREV_BLKP(bp))) > MAX_BLOCK_SIZE) {
+		prev_alloc = true;
+	}
+	if (!next_alloc && size + GET_SIZE(HDRP(NEXT_BLKP(bp))) +
+	    (prev_alloc ? 0 : GET_SIZE(HDRP(PREV_BLKP(bp)))) > MAX_BLOCK_SIZE) {
+		next_alloc = true;
+	}
+
+	// The header bit stands in for the previous block's footer.
+	if (next_alloc) {
+		CLR_PREV_ALLOC(HDRP(NEXT_BLKP(bp)));
+	}
 
 	if ((prev_alloc && next_alloc) ) {       /* Case 1 */
-		insert_freeblock(bp);
+		insert_freeblock(arena, bp);
 	} else if (prev_alloc && !next_alloc) {  /* Case 2 - block after free */
 
 		size += GET_SIZE(HDRP(NEXT_BLKP(bp)));
 		//Removes block after bp from freelist.
-		remove_freeblock(NEXT_BLKP(bp));
+		remove_freeblock(arena, NEXT_BLKP(bp));
 		
-		PUT(HDRP(bp), PACK(size, 0));
+		PUT(HDRP(bp), PACK(size, PREV_ALLOC));
 		PUT(FTRP(bp), PACK(size, 0));
 		
 		//Inserts coalesced block into freelist.
-		insert_freeblock(bp);
+		insert_freeblock(arena, bp);
 
 	} else if (!prev_alloc && next_alloc) {   /* Case 3 - block before free */
 		size += GET_SIZE(HDRP(PREV_BLKP(bp)));
 		//remove old block before bp from freelist.
-		remove_freeblock(PREV_BLKP(bp));
+		remove_freeblock(arena, PREV_BLKP(bp));
+
+		PUT(FTRP(bp), PACK(size, 0));
+		PUT(HDRP(PREV_BLKP(bp)), PACK(size,
+		    GET_PREV_ALLOC(HDRP(PREV_BLKP(bp)))));
+		//Move the bp pointer to the previous bp
+		bp = PREV_BLKP(bp);
+		//Insert into the freelist. 
+		insert_freeblock(arena, bp);
+	} else { /* Case 4 - both before, after free*/
+		//remove both old block, block after bp from freelist
+		remove_freeblock(arena, NEXT_BLKP(bp));
+		remove_freeblock(arena, PREV_BLKP(bp));
+		size += GET_SIZE(HDRP(PREV_BLKP(bp))) + 
+		    GET_SIZE(FTRP(NEXT_BLKP(bp)));
+		PUT(HDRP(PREV_BLKP(bp)), PACK(size,
+		    GET_PREV_ALLOC(HDRP(PREV_BLKP(bp)))));
+		PUT(FTRP(NEXT_BLKP(bp)), PACK(size, 0));
+		
+		//Move the bp pointer to the previous bp 
+		bp = PREV_BLKP(bp); 
+		//Insert into the freelist. 
+		insert_freeblock(arena, bp);
+	}
+	return (bp);
+}
+
+// /* 
+//  * Requires:
+//  *   The lock of "arena" is held.
+//  *
+//  * Effects:
+//  *   Extend "arena" with a free block and return that block's address.
+//  *   The arena's last segment grows in place if it ends at the break,
+//  *   and the new block merges with any free block before it; otherwise a
+//  *   new page-aligned segment is started.
+//  */
+static void *
+extend_heap(struct arena *arena, size_t words) 
+{
+	size_t size, pad, prev_alloc, fresh;
+	char *brk, *bp, *lo, *merged, *p;
+	bool top_fresh;
+	/* Allocate a multiple of ALIGNMENT to maintain alignment. */
+	size = ALIGNMENT * ((words * WSIZE + (ALIGNMENT - 1)) / ALIGNMENT);
+
+	pthread_mutex_lock(&sbrk_lock);
+	brk = (char *)mem_heap_hi() + 1;
+	// Memory that mem_sbrk has never handed out is still zero.
+	fresh = (brk >= (char *)mem_heap_fresh()) ? FRESH : 0;
+	if (brk == arena->seg_end) {
+		// Old epilogue becomes the new block's header.
+		if ((bp = mem_sbrk(size)) == (void *)-1) {
+			pthread_mutex_unlock(&sbrk_lock);
+			return (NULL);
+		}
+		arena->heap_size += size;
+		prev_alloc = GET_PREV_ALLOC(HDRP(bp));
+		// The page holding the old epilogue is already this arena's,
+		// and may be a slab run whose flag must survive.
+		lo = (char *)(((uintptr_t)bp + PAGESIZE - 1) &
+		    ~(uintptr_t)(PAGESIZE - 1));
+	} else {
+		// New segment: pad to a page, then an alignment word and the
+		// prologue hdr & ftr.  The first segment starts the heap and
+		// needs no padding.
+		pad = (brk == mem_heap_lo()) ? 0 :
+		    (PAGESIZE - ((uintptr_t)brk % PAGESIZE)) % PAGESIZE;
+		if ((bp = mem_sbrk(pad + (4 * WSIZE) + size)) == (void *)-1) {
+			pthread_mutex_unlock(&sbrk_lock);
+			return (NULL);
+		}
+		arena->heap_size += (4 * WSIZE) + size;
+		bp += pad;
+		lo = bp;
+		PUT(bp + WSIZE, PACK(DSIZE, 1 | PREV_ALLOC));
+		PUT(bp + (2 * WSIZE), PACK(DSIZE, 1));
+		bp += 4 * WSIZE;
+		prev_alloc = PREV_ALLOC;
+	}
+	arena->seg_end = bp + size;
+
+	/* Record the arena as owner of every page the segment now covers. */
+	if (lo < arena->seg_end) {
+		page_map_set(lo, arena->seg_end, (arena - arenas) + 1);
+	}
+	pthread_mutex_unlock(&sbrk_lock);
+
+	/* Initialize free block header/footer and the epilogue header. */
+	PUT(HDRP(bp), PACK(size, prev_alloc | fresh)); /* Free block header */
+	PUT(FTRP(bp), PACK(size, 0));                  /* Free block footer */
+	PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1));          /* New epilogue header */
+
+	// A fresh top block that merges with fresh memory stays fresh once
+	// its old footer and the old epilogue, now inside it, are cleared.
+	// Any of them under its links or tree node need not be, and must not.
+	top_fresh = !prev_alloc && fresh && GET_FRESH(HDRP(PREV_BLKP(bp)));
+	merged = coalesce(arena, bp);
+	if (top_fresh && merged != bp) {
+		for (p = HDRP(bp) - WSIZE; p <= HDRP(bp); p += WSIZE) {
+			if (p >= merged + sizeof(struct tree_node)) {
+				PUT(p, 0);
+			}
+		}
+		PUT(HDRP(merged), GET(HDRP(merged)) | FRESH);
+	}
+
+	return (merged);
+}
+
+/*
+ * Requires:
+ *   The lock of "arena" is held and "asize" is a valid block size.
+ *
+ * Effects:
+ *   Returns a free block of at least "asize" bytes at the end of "arena",
+ *   or NULL if the heap cannot grow.  A free block that ends the last
+ *   segment at the break is the wilderness.  It is used once no other
+ *   block fits, and the heap grows by only what it lacks, since the new
+ *   memory merges with it.  Otherwise the heap grows by at least
+ *   CHUNKSIZE, or by more as mm_set_heap_growth allows while demand lasts.
+ */
+static void *
+extend_top(struct arena *arena, size_t asize)
+{
+	size_t need, top;
+	char *bp;
+
+	pthread_mutex_lock(&sbrk_lock);
+	top = (arena->seg_end == (char *)mem_heap_hi() + 1 &&
+	    !GET_PREV_ALLOC(HDRP(arena->seg_end))) ?
+	    GET_SIZE(HDRP(PREV_BLKP(arena->seg_end))) : 0;
+	pthread_mutex_unlock(&sbrk_lock);
+	if (top >= asize) {
+		return (PREV_BLKP(arena->seg_end));
+	}
+
+	if (top != 0) {
+		need = MAX(asize - top, 2 * DSIZE);
+	} else {
+		// Growth that freed blocks could have served is not demand.
+		if (arena->freed > arena->grow_limit) {
+			arena->grow = CHUNKSIZE;
+		}
+		need = MAX(asize, MAX(CHUNKSIZE, MIN(arena->grow,
+		    arena->heap_size / growth_ratio) & ~(ALIGNMENT - 1)));
+		arena->grow = MIN(arena->grow * 2, growth_max);
+		arena->grow_limit = arena->freed + need;
+	}
+	if ((bp = extend_heap(arena, need / WSIZE)) != NULL &&
+	    GET_SIZE(HDRP(bp)) < asize) {
+		// Another arena moved the break first, so the extension
+		// started a segment of its own.
+		bp = extend_heap(arena, MAX(asize, CHUNKSIZE) / WSIZE);
+	}
+
+	return (bp);
+}
+
+/*
+ * Requires:
+ *   The lock of "arena" is held and "bp" is the first block of a free
+ *   list.
+ *
+ * Effects:
+ *   Returns "bp", or the block after it on its list if "bp" is the
+ *   wilderness, which is kept for last since it alone can grow.
+ */
+static void *
+skip_top(struct arena *arena, void *bp)
+{
 
-		PUT(FTRP(bp), PACK(size, 0));
-		PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0));
-		//Move the bp pointer to the previous bp
-		bp = PREV_BLKP(bp);
-		//Insert into the freelist. 
-		insert_freeblock(bp);
-	} else { /* Case 4 - both before, after free*/
-		//remove both old block, block after bp from freelist
-		remove_freeblock(NEXT_BLKP(bp));
-		remove_freeblock(PREV_BLKP(bp));
-		size += GET_SIZE(HDRP(PREV_BLKP(bp))) + 
-		    GET_SIZE(FTRP(NEXT_BLKP(bp)));
-		PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0));
-		PUT(FTRP(NEXT_BLKP(bp)), PACK(size, 0));
-		
-		//Move the bp pointer to the previous bp 
-		bp = PREV_BLKP(bp); 
-		//Insert into the freelist. 
-		insert_freeblock(bp);
+	if (NEXT_BLKP(bp) == arena->seg_end) {
+		return (LINKP(((struct free_links *)bp)->next));
 	}
+
 	return (bp);
 }
 
-// /* 
-//  * Requires:
-//  *   None.
-//  *
-//  * Effects:
-//  *   Extend the heap with a free block and return that block's address.
-//  */
+/*
+ * Requires:
+ *   The lock of "arena" is held.
+ *
+ * Effects:
+ *   Find a fit for a block with "asize" bytes.  Returns that block's address
+ *   or NULL if no suitable block was found.  A small block comes from its
+ *   exact bin or the next non-empty one.  Otherwise, apart from a scan of
+ *   at most fit_scan blocks of the list "asize" maps to, the bitmaps
+ *   locate the first non-empty list whose blocks all fit, so no list is
+ *   ever scanned further.  Failing that, the tree of large blocks gives
+ *   the best fit.
+ */
 static void *
-extend_heap(size_t words) 
+find_fit(struct arena *arena, size_t asize)
 {
-	size_t size;
+	uint32_t head;
+	uint64_t fl_map;
+	uint32_t sl_map;
 	void *bp;
-	/* Allocate an even number of words to maintain alignment. */
-	size = (words % 2) ? (words + 1) * WSIZE : words * WSIZE;
-	if ((bp = mem_sbrk(size)) == (void *)-1) {
-		return (NULL);
-	}
-		
+	int fl, sl;
 
-	/* Initialize free block header/footer and the epilogue header. */
-	PUT(HDRP(bp), PACK(size, 0));         /* Free block header */
-	PUT(FTRP(bp), PACK(size, 0));         /* Free block footer */
-	PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1)); /* New epilogue header */
+	// Large blocks get the best fit in the tree.
+	if (asize >= TREE_MIN_SIZE) {
+		return (tree_search(arena, asize));
+	}
 
+	if (asize < SMALL_BLOCK_SIZE) {
+		if ((bp = small_search(arena, asize)) != NULL) {
+			return (bp);
+		}
+		// Every block on the lists below is larger.
+		mapping_insert(SMALL_BLOCK_SIZE, &fl, &sl);
+	} else {
+		if (!mapping_search(asize, &fl, &sl)) {
+			return (tree_search(arena, asize));
+		}
+		// Scan the start of the list "asize" itself maps to; its
+		// first blocks often fit.
+		mapping_insert(asize, &fl, &sl);
+		head = arena->heads[fl][sl];
+		if (head != 0 &&
+		    (bp = list_fit(LINKP(head), asize, config.fit_scan)) != NULL) {
+			return (bp);
+		}
+		mapping_search(asize, &fl, &sl);
+	}
 
+	// Look for a non-empty list in this first level class first.
+	sl_map = arena->sl_bitmap[fl] & (~0U << sl);
+	if (sl_map == 0) {
+		// Move on to the next non-empty first level class.
+		fl_map = arena->fl_bitmap & (~(uint64_t)0 << (fl + 1));
+		if (fl_map == 0) {
+			/* No list fits, but the tree's blocks are larger. */
+			return (tree_search(arena, asize));
+		}
+		fl = __builtin_ctzll(fl_map);
+		sl_map = arena->sl_bitmap[fl];
+	}
+	sl = __builtin_ctz(sl_map);
 
-	// Defer coalescing
-	insert_freeblock(bp);
-	return (bp);
+	return (skip_top(arena, LINKP(arena->heads[fl][sl])));
 }
 
 /*
  * Requires:
- *   None.
+ *   The lock of the arena that owns "first" is held, and "first" is the
+ *   first block of a free list.
  *
  * Effects:
- *   Find a fit for a block with "asize" bytes.  Returns that block's address
- *   or NULL if no suitable block was found. 
+ *   Returns the smallest block of at least "asize" bytes among the first
+ *   "limit" blocks of the list, or NULL if none of them fits.  An exact
+ *   fit ends the scan early.
  */
 static void *
-find_fit(size_t asize)
+list_fit(void *first, size_t asize, unsigned limit)
 {
-	void *bp;
-	int i, bucket;
+	void *bp, *best;
+	size_t size;
 
-	
-	bucket = get_next_pow2_second(asize);
-		
-		
-	// Go through from smallest to largest bucket of minimum size possible
-	for (i = bucket; i < NUM_BUCKETS; i++) {
-		// go through the free list of the bucket
+	best = NULL;
+	bp = first;
+	for (; limit > 0; limit--) {
+		size = GET_SIZE(HDRP(bp));
+		if (size >= asize &&
+		    (best == NULL || size < GET_SIZE(HDRP(best)))) {
+			best = bp;
+			if (size == asize) {
+				break;
+			}
+		}
+		bp = LINKP(((struct free_links *)bp)->next);
+		if (bp == first) {
+			break;
+		}
+	}
 
-		for (bp = (dummy_head[i]).next; bp != &(dummy_head[i]); 
-		bp = ((struct pointer_data *)bp)->next) {
-			
-			if (asize <= GET_SIZE(HDRP(bp))) {
-				
-				return (bp);
-			} 
+	return (best);
+}
 
-			
+/*
+ * Requires:
+ *   The lock of "arena" is held and "asize" < SMALL_BLOCK_SIZE.
+ *
+ * Effects:
+ *   Returns the first block of the exact bin for "asize", or failing that
+ *   of the next non-empty bin, or NULL if every such bin is empty.
+ */
+static void *
+small_search(struct arena *arena, size_t asize)
+{
+	uint64_t map;
+	size_t bin, word;
+
+	bin = asize >> ALIGN_SHIFT;
+	if (arena->small_heads[bin] != 0) {
+		return (skip_top(arena, LINKP(arena->small_heads[bin])));
+	}
+	word = bin / 64;
+	map = arena->small_bitmap[word] & (~(uint64_t)0 << (bin % 64));
+	while (map == 0) {
+		if (++word == SMALL_MAP_WORDS) {
+			return (NULL);
 		}
+		map = arena->small_bitmap[word];
 	}
 
-	/* No fit was found. */
-	return (NULL);
-	
-	
+	return (skip_top(arena,
+	    LINKP(arena->small_heads[word * 64 + __builtin_ctzll(map)])));
 }
 
 /* 
@@ -517,95 +2791,438 @@ find_fit(size_t asize)
  *   "bp" is the address of a free block that is at least "asize" bytes.
  *
  * Effects:
- *   Place a block of "asize" bytes at the start of the free block "bp" and
- *   split that block if the remainder would be at least the minimum block
- *   size. 
+ *   Place a block of "asize" bytes in the free block "bp" and return its
+ *   address.  The free block is split if the remainder would be at least
+ *   split_min bytes.  A block of at least PLACE_HIGH_SIZE bytes is placed
+ *   at the high end and a smaller one at the low end, so that large and
+ *   small blocks, which tend to live for different times, gather apart.
+ *   Only the wilderness is always used from its low end, so that what is
+ *   left of it can still grow.
  */
-static void
-place(void *bp, size_t asize)
+static void *
+place(struct arena *arena, void *bp, size_t asize)
 {
 
-	size_t csize;
+	size_t csize, fresh;
+	char *abp, *rest;
 	csize = GET_SIZE(HDRP(bp));   
+	fresh = GET_FRESH(HDRP(bp));
 	
 	
-	//Checks if remnant block is large enough to justify splitting. 
-	if (csize > 2 * asize ) { // Large enough to split
-		PUT(HDRP(bp), PACK(asize, 1));
-		PUT(FTRP(bp), PACK(asize, 1));
-		remove_freeblock(bp);
-		bp = NEXT_BLKP(bp);
-		PUT(HDRP(bp), PACK(csize - asize, 0));
+	remove_freeblock(arena, bp);
+	if (csize - asize >= split_min && asize >= PLACE_HIGH_SIZE &&
+	    NEXT_BLKP(bp) != arena->seg_end) {
+		// The remainder keeps the low end and the old links, so it
+		// stays fresh.
+		PUT(HDRP(bp), PACK(csize - asize, GET_PREV_ALLOC(HDRP(bp)) |
+		    fresh));
 		PUT(FTRP(bp), PACK(csize - asize, 0));
+		insert_freeblock(arena, bp);
+
+		abp = NEXT_BLKP(bp);
+		PUT(HDRP(abp), PACK(asize, 1));
+		SET_PREV_ALLOC(HDRP(NEXT_BLKP(abp)));
+		page_map_reuse(HDRP(abp), HDRP(NEXT_BLKP(abp)));
+		return (abp);
+	}
+
+	//Checks if remnant block is large enough to justify splitting. 
+	if (csize - asize >= split_min) { // Large enough to split
+		PUT(HDRP(bp), PACK(asize, 1 | GET_PREV_ALLOC(HDRP(bp))));
+		page_map_reuse(HDRP(bp), HDRP(NEXT_BLKP(bp)));
+		rest = NEXT_BLKP(bp);
+		// The remainder's payload lies past the old links, so it
+		// stays fresh.
+		PUT(HDRP(rest), PACK(csize - asize, PREV_ALLOC | fresh));
+		PUT(FTRP(rest), PACK(csize - asize, 0));
 
 		// insert split block
-		insert_freeblock(bp);
+		insert_freeblock(arena, rest);
 		
 	} else { //Doesn't split block. 
-		PUT(HDRP(bp), PACK(csize, 1));
-		PUT(FTRP(bp), PACK(csize, 1));
-		remove_freeblock(bp);
+		PUT(HDRP(bp), PACK(csize, 1 | GET_PREV_ALLOC(HDRP(bp))));
+		SET_PREV_ALLOC(HDRP(NEXT_BLKP(bp)));
+		page_map_reuse(HDRP(bp), HDRP(NEXT_BLKP(bp)));
 	}
 
+	return (bp);
 }
 
+/*
+* Requires:
+*   The lock of "arena" is held and "bp" is a free block of "arena".
+*
+* Effects: 
+*   Inserts bp into the free list for its size and marks that list as
+*   non-empty, or into the tree if it is large.  The pages holding its
+*   header, links and footer are no longer released.
+*/
 static void
-insert_freeblock(void *bp) 
+insert_freeblock(struct arena *arena, void *bp) 
 {
-	int size, bucket;
+	size_t bin, links;
+	int fl, sl;
+
+	// Its header, links and footer were just written, and a split can
+	// put them on pages mm_trim gave back, which now hold data again.
+	links = (GET_SIZE(HDRP(bp)) >= TREE_MIN_SIZE) ?
+	    sizeof(struct tree_node) : sizeof(struct free_links);
+	page_map_reuse(HDRP(bp), (char *)bp + links);
+	page_map_reuse(FTRP(bp), FTRP(bp) + WSIZE);
 	
-	// Finds correct bucket and inserts
-	size = GET_SIZE(HDRP(bp));
-	bucket = get_next_pow2_second(size);	
-	insert_freelist(bp, &(dummy_head[bucket]));
+	if (GET_SIZE(HDRP(bp)) >= TREE_MIN_SIZE) {
+		tree_insert(arena, (struct tree_node *)bp);
+		return;
+	}
+
+	if (GET_SIZE(HDRP(bp)) < SMALL_BLOCK_SIZE) {
+		bin = GET_SIZE(HDRP(bp)) >> ALIGN_SHIFT;
+		insert_freelist(bp, &(arena->small_heads[bin]),
+		    ORDER_OF(GET_SIZE(HDRP(bp))));
+		arena->small_bitmap[bin / 64] |= (uint64_t)1 << (bin % 64);
+		return;
+	}
+
+	// Finds correct list and inserts
+	mapping_insert(GET_SIZE(HDRP(bp)), &fl, &sl);
+	insert_freelist(bp, &(arena->heads[fl][sl]),
+	    ORDER_OF(GET_SIZE(HDRP(bp))));
+	arena->fl_bitmap |= (uint64_t)1 << fl;
+	arena->sl_bitmap[fl] |= 1U << sl;
 }
 
 
 /*
 * Requires:
-*   
+*   "head" is the head of a free list and "bp" is a free block on none.
 *
 * Effects: 
-*   Inserts bp after target in the free linked list. 
+*   Inserts bp into the circular free list starting at head, so that the
+*   list hands out its blocks in "order": at the tail for FIFO, at the
+*   head for LIFO, or before the first block at a higher address.
 *
 */
 static void
-insert_freelist(void *bp,  void *target) 
+insert_freelist(void *bp, uint32_t *head, enum mm_order order) 
 {
 	
-	//Casts to struct pointer_data * to use next and prev from the struct.
-	struct pointer_data *targetNode, *bpNode;
-
-	targetNode = (struct pointer_data *)target;
-	bpNode = (struct pointer_data *)bp;
+	//Casts to struct free_links * to use next and prev from the struct.
+	struct free_links *first, *bpNode;
 
-	// inserts node
-	targetNode->prev->next = bpNode;
-	bpNode->next = targetNode;
-	bpNode->prev = targetNode->prev;
-	targetNode->prev = bpNode;
+	bpNode = (struct free_links *)bp;
 
-	
+	// An empty list becomes bp alone.
+	if (*head == 0) {
+		bpNode->next = bpNode->prev = LINK(bp);
+		*head = LINK(bp);
+		return;
+	}
 
+	// Links are offsets, so they order blocks like their addresses.
+	first = LINKP(*head);
+	if (order == MM_ORDER_ADDRESS) {
+		while (LINK(first) < LINK(bp)) {
+			first = LINKP(first->next);
+			if (first == LINKP(*head)) {
+				break;
+			}
+		}
+	}
 
+	// inserts node before "first"
+	((struct free_links *)LINKP(first->prev))->next = LINK(bp);
+	bpNode->next = LINK(first);
+	bpNode->prev = first->prev;
+	first->prev = LINK(bp);
+	if (order == MM_ORDER_LIFO ||
+	    (order == MM_ORDER_ADDRESS && LINK(bp) < *head)) {
+		*head = LINK(bp);
+	}
 }
 /*
 * Requires:
+*   The lock of "arena" is held and "bp" is a free block of "arena" whose
+*   header still holds the size it was inserted with.
 *
 * Effects: 
-*   Removes bp from its free linked list. 
+*   Removes bp from its free linked list, and clears the list's bitmap
+*   bits if it is now empty.  Large blocks are removed from the tree. 
 */
 static void 
-remove_freeblock(void *bp)
+remove_freeblock(struct arena *arena, void *bp)
 {
 	
-	//Casts to struct pointer_data * to use next and prev from the struct.
-	struct pointer_data *bpNode;
-	bpNode = (struct pointer_data *)bp;
+	//Casts to struct free_links * to use next and prev from the struct.
+	struct free_links *bpNode;
+	uint32_t *head;
+	size_t bin;
+	int fl, sl;
+	bpNode = (struct free_links *)bp;
+
+	if (GET_SIZE(HDRP(bp)) >= TREE_MIN_SIZE) {
+		tree_remove(arena, (struct tree_node *)bp);
+		return;
+	}
+	bin = GET_SIZE(HDRP(bp)) >> ALIGN_SHIFT;
+	if (bin < SMALL_BIN_COUNT) {
+		head = &(arena->small_heads[bin]);
+	} else {
+		mapping_insert(GET_SIZE(HDRP(bp)), &fl, &sl);
+		head = &(arena->heads[fl][sl]);
+	}
+
+	// Only a block alone on its list links to itself.
+	if (bpNode->next == LINK(bp)) {
+		*head = 0;
+		if (bin < SMALL_BIN_COUNT) {
+			arena->small_bitmap[bin / 64] &=
+			    ~((uint64_t)1 << (bin % 64));
+			return;
+		}
+		arena->sl_bitmap[fl] &= ~(1U << sl);
+		if (arena->sl_bitmap[fl] == 0) {
+			arena->fl_bitmap &= ~((uint64_t)1 << fl);
+		}
+		return;
+	}
 
 	// removes node
-	(bpNode->prev)->next = bpNode->next;
-	(bpNode->next)->prev = bpNode->prev;
+	((struct free_links *)LINKP(bpNode->prev))->next = bpNode->next;
+	((struct free_links *)LINKP(bpNode->next))->prev = bpNode->prev;
+	if (*head == LINK(bp)) {
+		*head = bpNode->next;
+	}
+}
+
+
+/*
+ * The following routines implement the tree of large free blocks.
+ */
+
+/*
+ * Requires:
+ *   "a" and "b" are free blocks.
+ *
+ * Effects:
+ *   Returns true if "a" orders before "b": it is smaller, or it is the same
+ *   size and at a lower address.
+ */
+static bool
+tree_less(struct tree_node *a, struct tree_node *b)
+{
+	size_t asize, bsize;
+
+	asize = GET_SIZE(HDRP(a));
+	bsize = GET_SIZE(HDRP(b));
+
+	return (asize < bsize || (asize == bsize && a < b));
+}
+
+/*
+ * Requires:
+ *   The lock of "arena" is held and "node" is a free block of at least
+ *   TREE_MIN_SIZE bytes that is not in the tree.
+ *
+ * Effects:
+ *   Insert "node" into the tree of "arena" and rebalance it.
+ */
+static void
+tree_insert(struct arena *arena, struct tree_node *node)
+{
+	struct tree_node *cur, *gp, *parent, *uncle;
+	int dir;
+
+	parent = NULL;
+	dir = 0;
+	for (cur = arena->tree_root; cur != NULL; cur = cur->child[dir]) {
+		parent = cur;
+		dir = tree_less(cur, node);
+	}
+	node->child[0] = node->child[1] = NULL;
+	node->parent = parent;
+	node->red = true;
+	if (parent == NULL) {
+		arena->tree_root = node;
+	} else {
+		parent->child[dir] = node;
+	}
+
+	// Repair a red node with a red parent, moving up the tree.
+	while ((parent = node->parent) != NULL && parent->red) {
+		gp = parent->parent;
+		dir = (parent == gp->child[1]);
+		uncle = gp->child[!dir];
+		if (uncle != NULL && uncle->red) {
+			parent->red = false;
+			uncle->red = false;
+			gp->red = true;
+			node = gp;
+		} else {
+			// Make "node" an outer grandchild, then rotate it up.
+			if (node == parent->child[!dir]) {
+				tree_rotate(arena, parent, dir);
+				parent = node;
+			}
+			tree_rotate(arena, gp, !dir);
+			parent->red = false;
+			gp->red = true;
+			break;
+		}
+	}
+	arena->tree_root->red = false;
+}
+
+/*
+ * Requires:
+ *   The lock of "arena" is held and "node" is in the tree of "arena".
+ *
+ * Effects:
+ *   Remove "node" from the tree of "arena" and rebalance it.
+ */
+static void
+tree_remove(struct arena *arena, struct tree_node *node)
+{
+	struct tree_node *next, *parent, *sibling, *x;
+	bool red;
+	int dir;
+
+	if (node->child[0] == NULL || node->child[1] == NULL) {
+		// At most one child, which takes the node's place.
+		x = node->child[node->child[0] == NULL];
+		parent = node->parent;
+		red = node->red;
+		tree_replace(arena, node, x);
+	} else {
+		// The next larger block takes the node's place and color.
+		for (next = node->child[1]; next->child[0] != NULL;
+		    next = next->child[0])
+			;
+		x = next->child[1];
+		red = next->red;
+		if (next->parent == node) {
+			parent = next;
+		} else {
+			parent = next->parent;
+			tree_replace(arena, next, x);
+			next->child[1] = node->child[1];
+			next->child[1]->parent = next;
+		}
+		tree_replace(arena, node, next);
+		next->child[0] = node->child[0];
+		next->child[0]->parent = next;
+		next->red = node->red;
+	}
+	if (red) {
+		return;
+	}
+
+	// "x" is short one black node; push the deficit up or fix it.
+	while (x != arena->tree_root && (x == NULL || !x->red)) {
+		dir = (parent->child[0] != x);
+		sibling = parent->child[!dir];
+		if (sibling->red) {
+			sibling->red = false;
+			parent->red = true;
+			tree_rotate(arena, parent, dir);
+			sibling = parent->child[!dir];
+		}
+		if ((sibling->child[0] == NULL || !sibling->child[0]->red) &&
+		    (sibling->child[1] == NULL || !sibling->child[1]->red)) {
+			sibling->red = true;
+			x = parent;
+			parent = x->parent;
+		} else {
+			if (sibling->child[!dir] == NULL ||
+			    !sibling->child[!dir]->red) {
+				sibling->child[dir]->red = false;
+				sibling->red = true;
+				tree_rotate(arena, sibling, !dir);
+				sibling = parent->child[!dir];
+			}
+			sibling->red = parent->red;
+			parent->red = false;
+			sibling->child[!dir]->red = false;
+			tree_rotate(arena, parent, dir);
+			x = arena->tree_root;
+		}
+	}
+	if (x != NULL) {
+		x->red = false;
+	}
+}
+
+/*
+ * Requires:
+ *   The lock of "arena" is held and "old" is in the tree of "arena".
+ *
+ * Effects:
+ *   Link "node", which may be NULL, into the place of "old" under the
+ *   parent of "old".  The children of "old" are left alone.
+ */
+static void
+tree_replace(struct arena *arena, struct tree_node *old,
+    struct tree_node *node)
+{
+
+	if (old->parent == NULL) {
+		arena->tree_root = node;
+	} else {
+		old->parent->child[old == old->parent->child[1]] = node;
+	}
+	if (node != NULL) {
+		node->parent = old->parent;
+	}
+}
+
+/*
+ * Requires:
+ *   The lock of "arena" is held and "node" has a child opposite "dir".
+ *
+ * Effects:
+ *   Rotate "node" down in direction "dir" (0 for left, 1 for right), so
+ *   its child on the other side takes its place.
+ */
+static void
+tree_rotate(struct arena *arena, struct tree_node *node, int dir)
+{
+	struct tree_node *up;
+
+	up = node->child[!dir];
+	node->child[!dir] = up->child[dir];
+	if (up->child[dir] != NULL) {
+		up->child[dir]->parent = node;
+	}
+	tree_replace(arena, node, up);
+	up->child[dir] = node;
+	node->parent = up;
+}
+
+/*
+ * Requires:
+ *   The lock of "arena" is held.
+ *
+ * Effects:
+ *   Returns the best fit for a block with "asize" bytes in the tree of
+ *   "arena": the lowest addressed of its smallest blocks that are large
+ *   enough.  Returns NULL if no block is large enough.
+ */
+static struct tree_node *
+tree_search(struct arena *arena, size_t asize)
+{
+	struct tree_node *best, *node;
+
+	best = NULL;
+	node = arena->tree_root;
+	while (node != NULL) {
+		if (GET_SIZE(HDRP(node)) >= asize) {
+			best = node;
+			node = node->child[0];
+		} else {
+			node = node->child[1];
+		}
+	}
+
+	return (best);
 }
 
 
@@ -624,13 +3241,33 @@ static void
 checkblock(void *bp)
 {
 	bool alloc = GET_ALLOC(HDRP(bp)); 
+	char *p;
 
-	//Given checks of the block: 
-	if ((uintptr_t)bp % ALIGNMENT)
-		printf("Error: %p is not doubleword aligned\n", bp);
-	if (GET(HDRP(bp)) != GET(FTRP(bp)))
+	//Given checks of the block: the prologue, the only block of DSIZE
+	//bytes, is only doubleword aligned.
+	if ((uintptr_t)bp % (GET_SIZE(HDRP(bp)) == DSIZE ? DSIZE : ALIGNMENT))
+		printf("Error: %p is not aligned\n", bp);
+	if (!alloc && GET_SIZE(HDRP(bp)) != GET_SIZE(FTRP(bp)))
 		printf("Error: header does not match footer\n");
-	
+	if (!alloc && GET_FRESH(HDRP(bp))) {
+		for (p = (char *)bp + sizeof(struct tree_node); p < FTRP(bp);
+		    p++) {
+			if (*p != 0) {
+				printf("Error: fresh block %p not zero at "
+				    "%p\n", bp, p);
+				break;
+			}
+		}
+	}
+	if (!GET_PREV_ALLOC(HDRP(NEXT_BLKP(bp))) != !alloc)
+		printf("Error: %p next block's prev allocated bit is wrong\n",
+		    bp);
+	if (!alloc && ((PAGE_GET(PAGE_INDEX(HDRP(bp))) & PAGE_RELEASED) ||
+	    (PAGE_GET(PAGE_INDEX(bp)) & PAGE_RELEASED) ||
+	    (PAGE_GET(PAGE_INDEX(FTRP(bp))) & PAGE_RELEASED)))
+		printf("Error: free block %p has its header, links or footer "
+		    "on a released page\n", bp);
+
 
 	//Additional block checks: 
 	
@@ -640,80 +3277,209 @@ checkblock(void *bp)
 	}
 	//If the block is free, check if in freelist and that pointers are in range
 	if(!alloc) {
-		// Coalescing: 
-		if (GET_ALLOC(HDRP(PREV_BLKP(bp)))) {
+		// Coalescing, unless the merged block would be too large: 
+		if (!GET_PREV_ALLOC(HDRP(bp)) && GET_SIZE(HDRP(bp)) +
+		    GET_SIZE(HDRP(PREV_BLKP(bp))) <= MAX_BLOCK_SIZE) {
 			printf("Error: Previous block not coalesced\n");
 		}
-		if (GET_ALLOC(HDRP(NEXT_BLKP(bp)))) {
+		if (!GET_ALLOC(HDRP(NEXT_BLKP(bp))) && GET_SIZE(HDRP(bp)) +
+		    GET_SIZE(HDRP(NEXT_BLKP(bp))) <= MAX_BLOCK_SIZE) {
 			printf("Error: Next block not coalesced\n");
 		}
+		// Tree nodes are checked by check_tree instead.
+		if (GET_SIZE(HDRP(bp)) >= TREE_MIN_SIZE) {
+			return;
+		}
 		
-		struct pointer_data *bpNode, *prevbp, *nextbp;
-		bpNode = (struct pointer_data *)bp;
-		prevbp = bpNode->prev; 
-		nextbp= bpNode->next;
+		struct arena *arena = arena_of(bp);
+		struct free_links *bpNode;
+		void *prevbp, *nextbp;
+		bpNode = (struct free_links *)bp;
 		//checks if free block is not in the free list
-		if ((prevbp == NULL) || (nextbp == NULL)) {
+		if ((bpNode->prev == 0) || (bpNode->next == 0)) {
 			printf("Error: free block %p not in free list\n", bp);
+			return;
 		}
-		//checks pointers point to valid addresses
-		if (prevbp <= (struct pointer_data *)mem_heap_lo()) {
-			printf("Error: bp %p prev- %p lo out of range\n", bp, prevbp);
-		}
-		if (nextbp <= (struct pointer_data *)mem_heap_lo()) {
-			printf("Error: bp %p next- %p lo out of range\n", bp, nextbp);
-		}
-		if (prevbp >= (struct pointer_data *)mem_heap_hi()) {
-			printf("Error: bp %p prev- %p high out of range\n", bp, prevbp);
-		}
-		if (nextbp >= (struct pointer_data *)mem_heap_hi()) {
-			printf("Error: bp %p next- %p high out of range\n", bp, nextbp);
-		}
-		// checks pointers point to valid free blocks
-		// check each not a dummy head and is free
-		if (!((prevbp >= (struct pointer_data *)mem_heap_lo() 
-		    && prevbp < ((struct pointer_data *)mem_heap_lo()) 
-		    + NUM_BUCKETS) || !GET_ALLOC(HDRP(prevbp)))) {
+		prevbp = LINKP(bpNode->prev); 
+		nextbp = LINKP(bpNode->next);
+		// checks links point to free blocks of the same arena
+		if (prevbp <= mem_heap_lo() || prevbp >= mem_heap_hi()) {
+			printf("Error: bp %p prev- %p out of range\n", bp,
+			    prevbp);
+		} else if (GET_ALLOC(HDRP(prevbp)) ||
+		    arena_of(prevbp) != arena) {
 			printf("Error: prev doesn't point to free block\n");
 		}
-		if (!((nextbp >= (struct pointer_data *)mem_heap_lo() 
-		    && nextbp < ((struct pointer_data *)mem_heap_lo()) 
-		    + NUM_BUCKETS) || !GET_ALLOC(HDRP(nextbp)))) {
+		if (nextbp <= mem_heap_lo() || nextbp >= mem_heap_hi()) {
+			printf("Error: bp %p next- %p out of range\n", bp,
+			    nextbp);
+		} else if (GET_ALLOC(HDRP(nextbp)) ||
+		    arena_of(nextbp) != arena) {
 			printf("Error: nextbp doesn't point to free block\n");
 		}
 	} 	
 }
 
+/*
+ * Requires:
+ *   "run" is the address of a slab run.
+ *
+ * Effects:
+ *   Perform a check of the slab run "run" and its free objects.
+ */
+static void
+checkrun(struct slab_run *run)
+{
+	char *bp, *objs;
+	int size, nfree;
+
+	if (run->class < 0 || run->class >= SLAB_NUM_CLASSES) {
+		printf("Error: run %p has bad class %d\n", run, run->class);
+		return;
+	}
+	size = slab_sizes[run->class];
+	objs = (char *)run + SLAB_RUN_HDR;
+	if (run->nobjs != (int)(SLAB_RUN_SIZE - SLAB_RUN_HDR) / size)
+		printf("Error: run %p has bad object count\n", run);
+	if (run->fresh < objs || run->fresh > objs + (run->nobjs * size))
+		printf("Error: run %p fresh pointer out of range\n", run);
+
+	// Count the returned objects plus the never handed out ones.
+	nfree = (objs + (run->nobjs * size) - run->fresh) / size;
+	for (bp = run->free; bp != NULL && nfree <= run->nobjs;
+	    bp = *(void **)bp) {
+		if (bp < objs || bp >= run->fresh || (bp - objs) % size) {
+			printf("Error: run %p free object %p invalid\n", run, bp);
+			return;
+		}
+		nfree++;
+	}
+	if (nfree != run->nfree)
+		printf("Error: run %p free count %d, expected %d\n", run,
+		    nfree, run->nfree);
+}
+
 /*
 * Requires: 
 *   None. 
 *
 * Effects:
-*   Preform a check of the segregated free lists for consistency. 
+*   Preform a check of the segregated free lists and the tree of "arena"
+*   for consistency. 
 *
 */
 void 
-check_freelist(bool verbose)
+check_freelist(struct arena *arena, bool verbose)
 {
-	void *bp;
-	dummy_head = (struct pointer_data *)mem_heap_lo();
-	// progress through linked list
-	for (int i = 0; i < NUM_BUCKETS; i++) {
-		if(verbose) {
-			printf("Entered Bucket %d\n", i);
+	void *bp, *head;
+	int fl, sl;
+	// Each exact bin holds only blocks of its own size.
+	for (int i = 0; i < SMALL_BIN_COUNT; i++) {
+		if (((arena->small_bitmap[i / 64] >> (i % 64)) & 1) !=
+		    (arena->small_heads[i] != 0)) {
+			printf("Error: small bin bitmap wrong for %d\n", i);
 		}
-     	bp = (dummy_head[i]).next;
-		//Iterates through current bucket, checks allocation
-		while(bp != &(dummy_head[i])) {
+		head = bp = (arena->small_heads[i] == 0) ? NULL :
+		    LINKP(arena->small_heads[i]);
+		while (bp != NULL) {
 			if (GET_ALLOC(HDRP(bp)) || GET_ALLOC(FTRP(bp))) {
 				printf("Error: allocated block in freelist\n");
 			}
-			bp = ((struct pointer_data *)bp)->next;
+			if (GET_SIZE(HDRP(bp)) >> ALIGN_SHIFT != (size_t)i) {
+				printf("Error: %p in wrong bin\n", bp);
+			}
+			if (((struct free_links *)LINKP(((struct
+			    free_links *)bp)->next))->prev != LINK(bp)) {
+				printf("Error: %p next block's prev is wrong\n",
+				    bp);
+			}
+			bp = LINKP(((struct free_links *)bp)->next);
+			if (bp == head) {
+				bp = NULL;
+			}
+		}
+	}
+	// progress through linked list
+	for (int i = 0; i < FL_INDEX_COUNT; i++) {
+		if (((arena->fl_bitmap >> i) & 1) != (arena->sl_bitmap[i] != 0)) {
+			printf("Error: first level bitmap wrong for %d\n", i);
 		}
-		if(verbose) {
-			printf("Exited Bucket %d\n", i);
+		for (int j = 0; j < SL_INDEX_COUNT; j++) {
+			if(verbose) {
+				printf("Entered List %d/%d\n", i, j);
+			}
+			if (((arena->sl_bitmap[i] >> j) & 1) !=
+			    (arena->heads[i][j] != 0)) {
+				printf("Error: second level bitmap wrong for "
+				    "%d/%d\n", i, j);
+			}
+			head = bp = (arena->heads[i][j] == 0) ? NULL :
+			    LINKP(arena->heads[i][j]);
+			//Iterates through current list, checks allocation
+			while (bp != NULL) {
+				if (GET_ALLOC(HDRP(bp)) || GET_ALLOC(FTRP(bp))) {
+					printf("Error: allocated block in freelist\n");
+				}
+				mapping_insert(GET_SIZE(HDRP(bp)), &fl, &sl);
+				if (fl != i || sl != j) {
+					printf("Error: %p in wrong list\n", bp);
+				}
+				if (((struct free_links *)LINKP(((struct
+				    free_links *)bp)->next))->prev != LINK(bp)) {
+					printf("Error: %p next block's prev is wrong\n",
+					    bp);
+				}
+				bp = LINKP(((struct free_links *)bp)->next);
+				if (bp == head) {
+					bp = NULL;
+				}
+			}
+			if(verbose) {
+				printf("Exited List %d/%d\n", i, j);
+			}
 		}
 	}
+	if (arena->tree_root != NULL && arena->tree_root->red) {
+		printf("Error: tree root is red\n");
+	}
+	check_tree(arena->tree_root, NULL);
+}
+
+/*
+ * Requires:
+ *   "node" is NULL or a node of a tree, and "parent" is its parent.
+ *
+ * Effects:
+ *   Perform a check of the subtree "node" for order, red-black balance and
+ *   free blocks.  Returns the number of black nodes on each path down from
+ *   "node", or -1 if they differ.
+ */
+static int
+check_tree(struct tree_node *node, struct tree_node *parent)
+{
+	int left, right;
+
+	if (node == NULL) {
+		return (0);
+	}
+	if (node->parent != parent)
+		printf("Error: tree node %p has wrong parent\n", node);
+	if (GET_ALLOC(HDRP(node)) || GET_SIZE(HDRP(node)) < TREE_MIN_SIZE)
+		printf("Error: tree node %p is not a large free block\n", node);
+	if (node->red && parent != NULL && parent->red)
+		printf("Error: red tree node %p has a red parent\n", node);
+	if ((node->child[0] != NULL && !tree_less(node->child[0], node)) ||
+	    (node->child[1] != NULL && !tree_less(node, node->child[1])))
+		printf("Error: tree node %p is out of order\n", node);
+
+	left = check_tree(node->child[0], node);
+	right = check_tree(node->child[1], node);
+	if (left != right || left == -1) {
+		printf("Error: tree node %p is unbalanced\n", node);
+		return (-1);
+	}
+
+	return (left + !node->red);
 }
 
 /* 
@@ -721,39 +3487,82 @@ check_freelist(bool verbose)
  *   None.
  *
  * Effects:
- *   Perform a minimal check of the heap for consistency. 
+ *   Perform a minimal check of the heap for consistency.  Every segment
+ *   starts at the first page of a run of pages with the same owner, and
+ *   every slab page is also checked as a run.
  */
 void
 checkheap(bool verbose, bool freelist) 
 {
-	void *bp;
-
-	if (verbose)
-		printf("Heap (%p):\n", heap_listp);
+	struct huge_block *huge;
+	void *bp, *heap_listp;
+	uintptr_t lo;
+	size_t page, npages;
+	int i;
 
-	//Checks the prologue header
-	if (GET_SIZE(HDRP(heap_listp)) != DSIZE ||
-	    !GET_ALLOC(HDRP(heap_listp)))
-		printf("Bad prologue header\n");
-	checkblock(heap_listp);
+	npages = PAGE_INDEX(mem_heap_hi()) + 1;
+	lo = (uintptr_t)mem_heap_lo();
+	for (page = 0; page < npages; page++) {
+		if ((PAGE_GET(page) & (PAGE_SLAB | PAGE_RELEASED)) ==
+		    (PAGE_SLAB | PAGE_RELEASED))
+			printf("Error: slab page %zu is released\n", page);
+		if (PAGE_GET(page) & PAGE_SLAB) {
+			checkrun((struct slab_run *)((lo & ~(PAGESIZE - 1)) +
+			    (page * PAGESIZE)));
+		}
+		if (PAGE_GET(page) == 0 || (page > 0 &&
+		    (PAGE_GET(page) & PAGE_ARENA_MASK) ==
+		    (PAGE_GET(page - 1) & PAGE_ARENA_MASK)))
+			continue;
+		heap_listp = (char *)MAX(lo, (lo & ~(PAGESIZE - 1)) +
+		    (page * PAGESIZE)) + DSIZE;
 
-	//Iterates through memory, checks each block 
-	for (bp = heap_listp; GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp)) {
+		if (verbose)
+			printf("Heap (%p) arena %d:\n", heap_listp,
+			    (PAGE_GET(page) & PAGE_ARENA_MASK) - 1);
+
+		//Checks the prologue header
+		if (GET_SIZE(HDRP(heap_listp)) != DSIZE ||
+		    !GET_ALLOC(HDRP(heap_listp)))
+			printf("Bad prologue header\n");
+		checkblock(heap_listp);
+
+		//Iterates through memory, checks each block 
+		for (bp = heap_listp; GET_SIZE(HDRP(bp)) > 0;
+		    bp = NEXT_BLKP(bp)) {
+			if (verbose)
+				printblock(bp);
+			checkblock(bp);
+		}
+		//Prints epilogue if verbose
 		if (verbose)
 			printblock(bp);
-		checkblock(bp);
+			
+		//Checks epilogue 
+		if (GET_SIZE(HDRP(bp)) != 0 || !GET_ALLOC(HDRP(bp)))
+			printf("Bad epilogue header\n");
 	}
-	//Prints epilogue if verbose
-	if (verbose)
-		printblock(bp);
-		
-	//Checks epilogue 
-	if (GET_SIZE(HDRP(bp)) != 0 || !GET_ALLOC(HDRP(bp)))
-		printf("Bad epilogue header\n");
 	
-	//Checks freelist if requested 
-	if (freelist) 
-		check_freelist(verbose);
+	//Checks the huge blocks
+	for (huge = huge_list.next; huge != &huge_list; huge = huge->next) {
+		bp = (char *)huge + HUGE_HDR;
+		if (verbose)
+			printf("%p: huge: [%zu]\n", bp, huge->len);
+		if (!IS_HUGE(bp) || huge->len % PAGESIZE != 0 ||
+		    huge->lead >= PAGESIZE)
+			printf("Error: bad huge block %p\n", bp);
+		if (huge->next->prev != huge)
+			printf("Error: huge block %p next's prev is wrong\n",
+			    bp);
+	}
+
+	//Checks freelists of the current arenas if requested 
+	if (freelist) {
+		for (i = 0; i < NUM_ARENAS; i++) {
+			if (arenas[i].epoch == heap_epoch)
+				check_freelist(&arenas[i], verbose);
+		}
+	}
 }
 
 /*
@@ -772,15 +3581,22 @@ printblock(void *bp)
 	checkheap(false, false);
 	hsize = GET_SIZE(HDRP(bp));
 	halloc = GET_ALLOC(HDRP(bp));  
-	fsize = GET_SIZE(FTRP(bp));
-	falloc = GET_ALLOC(FTRP(bp));  
 
 	if (hsize == 0) {
 		printf("%p: end of heap\n", bp);
 		return;
 	}
 
-	printf("%p: header: [%zu:%c] footer: [%zu:%c]\n", bp, 
-	    hsize, (halloc ? 'a' : 'f'), 
+	// Only free blocks have a footer.
+	if (halloc) {
+		printf("%p: header: [%zu:a:%c]\n", bp, hsize,
+		    (GET_PREV_ALLOC(HDRP(bp)) ? 'a' : 'f'));
+		return;
+	}
+	fsize = GET_SIZE(FTRP(bp));
+	falloc = GET_ALLOC(FTRP(bp));  
+
+	printf("%p: header: [%zu:f:%c] footer: [%zu:%c]\n", bp, 
+	    hsize, (GET_PREV_ALLOC(HDRP(bp)) ? 'a' : 'f'), 
 	    fsize, (falloc ? 'a' : 'f'));
 }
@@ -4,8 +4,66 @@
 
 int	 mm_init(void);
 void	*mm_malloc(size_t size);
+void	*mm_calloc(size_t nmemb, size_t size);
+void	*mm_memalign(size_t alignment, size_t size);
+void	*mm_aligned_alloc(size_t alignment, size_t size);
 void	 mm_free(void *ptr);
+void	 mm_free_sized(void *ptr, size_t size);
+size_t	 mm_usable_size(void *ptr);
+int	 mm_owns(void *ptr);
+size_t	 mm_malloc_batch(size_t size, size_t n, void **out);
+void	 mm_free_batch(void **ptrs, size_t n);
 void	*mm_realloc(void *ptr, size_t size);
+void	 mm_tcache_flush(void);
+int	 mm_trim(size_t pad);
+void	 mm_set_mmap_threshold(size_t threshold);
+void	 mm_set_heap_growth(size_t max, size_t ratio);
+void	 mm_set_split_threshold(size_t threshold);
+
+/*
+ * The orders in which a free list can hand out its blocks, and the free list
+ * configuration.  Each power of two of free block sizes has its own order:
+ * "order[i]" applies to the lists of blocks from 2^(i + 4) bytes up to
+ * twice that, so the classes run from the smallest block of 16 bytes to
+ * the 4 KB blocks that are kept in a tree by size instead.  "fit_scan" is
+ * how many blocks of the list a request maps to are searched for the best
+ * fit; zero skips that list.
+ */
+enum mm_order {
+	MM_ORDER_FIFO,		/* Oldest free block first */
+	MM_ORDER_LIFO,		/* Most recently freed block first */
+	MM_ORDER_ADDRESS	/* Lowest address first */
+};
+
+#define MM_ORDER_CLASSES 8	/* Powers of two of free block sizes */
+
+struct mm_config {
+	enum	mm_order order[MM_ORDER_CLASSES]; /* By power of two of size */
+	unsigned fit_scan;
+};
+
+void	 mm_get_config(struct mm_config *out);
+int	 mm_set_config(const struct mm_config *cfg);
+
+/*
+ * A region hands out objects that are all freed at once.
+ */
+struct mm_region;
+
+struct mm_region *mm_region_create(void);
+void	*mm_region_alloc(struct mm_region *region, size_t size);
+void	 mm_region_reset(struct mm_region *region);
+void	 mm_region_destroy(struct mm_region *region);
+
+/*
+ * A pool hands out objects of one size that are freed one at a time.
+ */
+struct mm_pool;
+
+struct mm_pool *mm_pool_create(size_t obj_size, size_t align);
+void	*mm_pool_alloc(struct mm_pool *pool);
+void	 mm_pool_free(struct mm_pool *pool, void *ptr);
+void	 mm_pool_destroy(struct mm_pool *pool);
 
 /*
  * Students work in teams of one or two.  Teams enter their team name, personal
@@ -0,0 +1,256 @@
+/*
+ * C++ adaptors over the allocator in mm.c: a standard allocator for any
+ * container, and, under C++17, memory resources for the std::pmr ones.
+ * The program must have called mem_init and mm_init before any of these
+ * allocate, unless mm_new.cc is linked in and has done so.
+ */
+
+#ifndef MM_ALLOCATOR_HPP
+#define MM_ALLOCATOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <new>
+#include <type_traits>
+
+#if __cplusplus >= 201703L
+#include <memory_resource>
+#endif
+
+extern "C" {
+#include "mm.h"
+}
+
+namespace mm {
+
+/* Every block from mm_malloc is aligned to at least this many bytes. */
+constexpr std::size_t min_align = 16;
+
+/*
+ * Requires:
+ *   None.
+ *
+ * Effects:
+ *   Allocate a block with at least "size" bytes of payload that starts at a
+ *   multiple of "align".  A zero-byte request still gets a unique block.
+ *   Returns the address of this block if successful and NULL otherwise.
+ */
+inline void *
+allocate_bytes(std::size_t size, std::size_t align)
+{
+
+	if (size == 0) {
+		size = 1;
+	}
+	if (align <= min_align) {
+		return (mm_malloc(size));
+	}
+
+	return (mm_memalign(align, size));
+}
+
+/*
+ * Requires:
+ *   "p" is NULL or was returned by allocate_bytes with "size".
+ *
+ * Effects:
+ *   Free the block "p".
+ */
+inline void
+deallocate_bytes(void *p, std::size_t size)
+{
+
+	mm_free_sized(p, size == 0 ? 1 : size);
+}
+
+/*
+ * A stateless allocator, so every instance can free what any other
+ * allocated.  Deallocation passes the size on to mm_free_sized.
+ */
+template <class T>
+class allocator {
+public:
+	using value_type = T;
+	using propagate_on_container_move_assignment = std::true_type;
+	using is_always_equal = std::true_type;
+
+	allocator() noexcept = default;
+
+	template <class U>
+	allocator(const allocator<U> &) noexcept
+	{
+	}
+
+	T *
+	allocate(std::size_t n)
+	{
+		void *p;
+
+		if (n > std::numeric_limits<std::size_t>::max() / sizeof(T)) {
+			throw std::bad_array_new_length();
+		}
+		if ((p = allocate_bytes(n * sizeof(T), alignof(T))) == NULL) {
+			throw std::bad_alloc();
+		}
+
+		return (static_cast<T *>(p));
+	}
+
+	void
+	deallocate(T *p, std::size_t n) noexcept
+	{
+
+		deallocate_bytes(p, n * sizeof(T));
+	}
+};
+
+template <class T, class U>
+inline bool
+operator==(const allocator<T> &, const allocator<U> &) noexcept
+{
+
+	return (true);
+}
+
+template <class T, class U>
+inline bool
+operator!=(const allocator<T> &, const allocator<U> &) noexcept
+{
+
+	return (false);
+}
+
+#if __cplusplus >= 201703L
+
+/*
+ * A memory resource over mm_malloc and mm_memalign.  All instances share
+ * the one heap, so any of them can free what another allocated.
+ */
+class resource : public std::pmr::memory_resource {
+protected:
+	void *
+	do_allocate(std::size_t bytes, std::size_t align) override
+	{
+		void *p;
+
+		if ((p = allocate_bytes(bytes, align)) == NULL) {
+			throw std::bad_alloc();
+		}
+
+		return (p);
+	}
+
+	void
+	do_deallocate(void *p, std::size_t bytes, std::size_t) override
+	{
+
+		deallocate_bytes(p, bytes);
+	}
+
+	bool
+	do_is_equal(const std::pmr::memory_resource &other) const
+	    noexcept override
+	{
+
+		return (dynamic_cast<const resource *>(&other) != NULL);
+	}
+};
+
+/*
+ * Requires:
+ *   None.
+ *
+ * Effects:
+ *   Returns a resource that lives as long as the program.
+ */
+inline resource *
+heap_resource() noexcept
+{
+	static resource r;
+
+	return (&r);
+}
+
+/*
+ * A monotonic resource backed by an mm region.  Deallocation does nothing;
+ * memory is given back all at once by release or the destructor.  Like the
+ * region under it, it must only be used by one thread at a time.
+ */
+class region_resource : public std::pmr::memory_resource {
+public:
+	region_resource()
+	{
+
+		if ((region = mm_region_create()) == NULL) {
+			throw std::bad_alloc();
+		}
+	}
+
+	region_resource(const region_resource &) = delete;
+	region_resource &operator=(const region_resource &) = delete;
+
+	~region_resource() override
+	{
+
+		mm_region_destroy(region);
+	}
+
+	/* Free everything allocated from this resource. */
+	void
+	release() noexcept
+	{
+
+		mm_region_reset(region);
+	}
+
+protected:
+	void *
+	do_allocate(std::size_t bytes, std::size_t align) override
+	{
+		std::uintptr_t p;
+
+		// Region objects are only aligned to min_align, so pad for
+		// anything stricter.
+		if (align > min_align) {
+			if (bytes > std::numeric_limits<std::size_t>::max() -
+			    align) {
+				throw std::bad_alloc();
+			}
+			bytes += align - min_align;
+		}
+		p = reinterpret_cast<std::uintptr_t>(
+		    mm_region_alloc(region, bytes == 0 ? 1 : bytes));
+		if (p == 0) {
+			throw std::bad_alloc();
+		}
+		if (align > min_align) {
+			p = (p + (align - 1)) & ~static_cast<std::uintptr_t>(
+			    align - 1);
+		}
+
+		return (reinterpret_cast<void *>(p));
+	}
+
+	void
+	do_deallocate(void *, std::size_t, std::size_t) override
+	{
+	}
+
+	bool
+	do_is_equal(const std::pmr::memory_resource &other) const
+	    noexcept override
+	{
+
+		return (this == &other);
+	}
+
+private:
+	struct mm_region *region;
+};
+
+#endif /* __cplusplus >= 201703L */
+
+} // namespace mm
+
+#endif /* MM_ALLOCATOR_HPP */
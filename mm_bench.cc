@@ -0,0 +1,209 @@
+/*
+ * mm_bench.cc - Times standard containers on the C++ adaptors in
+ * mm_allocator.hpp against the same containers on the default allocator.
+ *
+ * Each workload is timed with fsecs, like the trace replays in mdriver.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory_resource>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+extern "C" {
+#include "fsecs.h"
+#include "memlib.h"
+}
+#include "mm_allocator.hpp"
+
+#define NELEMS	20000	/* Elements inserted by each workload */
+
+/* The timing package reports through mdriver's verbosity flag. */
+extern "C" int verbose;
+int verbose = 0;
+
+/*
+ * Requires:
+ *   None.
+ *
+ * Effects:
+ *   Grow a vector one element at a time, so that it is reallocated
+ *   repeatedly, and then free it.
+ */
+template <class Vector>
+static void
+vector_workload(Vector v)
+{
+	int i;
+
+	for (i = 0; i < NELEMS; i++) {
+		v.push_back(i);
+	}
+}
+
+/*
+ * Requires:
+ *   None.
+ *
+ * Effects:
+ *   Fill a hash map, erase every other key, refill it, and then free it.
+ *   Every node is a separate small allocation.
+ */
+template <class Map>
+static void
+map_workload(Map m)
+{
+	int i;
+
+	for (i = 0; i < NELEMS; i++) {
+		m.emplace(i, i);
+	}
+	for (i = 0; i < NELEMS; i += 2) {
+		m.erase(i);
+	}
+	for (i = 0; i < NELEMS; i += 2) {
+		m.emplace(i, -i);
+	}
+}
+
+template <class T>
+using mm_vector = std::vector<T, mm::allocator<T>>;
+
+template <class K, class V>
+using mm_map = std::unordered_map<K, V, std::hash<K>, std::equal_to<K>,
+    mm::allocator<std::pair<const K, V>>>;
+
+static void
+std_vector(void *)
+{
+
+	vector_workload(std::vector<int>());
+}
+
+static void
+mm_vector_run(void *)
+{
+
+	vector_workload(mm_vector<int>());
+}
+
+static void
+std_map(void *)
+{
+
+	map_workload(std::unordered_map<int, int>());
+}
+
+static void
+mm_map_run(void *)
+{
+
+	map_workload(mm_map<int, int>());
+}
+
+static void
+pmr_vector_newdel(void *)
+{
+
+	vector_workload(std::pmr::vector<int>(
+	    std::pmr::new_delete_resource()));
+}
+
+static void
+pmr_vector_mm(void *)
+{
+
+	vector_workload(std::pmr::vector<int>(mm::heap_resource()));
+}
+
+static void
+pmr_vector_monotonic(void *)
+{
+	std::pmr::monotonic_buffer_resource r;
+
+	vector_workload(std::pmr::vector<int>(&r));
+}
+
+static void
+pmr_vector_region(void *)
+{
+	mm::region_resource r;
+
+	vector_workload(std::pmr::vector<int>(&r));
+}
+
+static void
+pmr_map_newdel(void *)
+{
+
+	map_workload(std::pmr::unordered_map<int, int>(
+	    std::pmr::new_delete_resource()));
+}
+
+static void
+pmr_map_mm(void *)
+{
+
+	map_workload(std::pmr::unordered_map<int, int>(mm::heap_resource()));
+}
+
+static void
+pmr_map_monotonic(void *)
+{
+	std::pmr::monotonic_buffer_resource r;
+
+	map_workload(std::pmr::unordered_map<int, int>(&r));
+}
+
+static void
+pmr_map_region(void *)
+{
+	mm::region_resource r;
+
+	map_workload(std::pmr::unordered_map<int, int>(&r));
+}
+
+/* A workload and the allocator it runs on. */
+struct bench {
+	const char	*name;
+	fsecs_test_funct baseline;	/* On the default allocator */
+	fsecs_test_funct subject;	/* On mm */
+};
+
+static const struct bench benches[] = {
+	{ "vector/allocator", std_vector, mm_vector_run },
+	{ "unordered_map/allocator", std_map, mm_map_run },
+	{ "pmr::vector/resource", pmr_vector_newdel, pmr_vector_mm },
+	{ "pmr::vector/monotonic", pmr_vector_monotonic, pmr_vector_region },
+	{ "pmr::unordered_map/resource", pmr_map_newdel, pmr_map_mm },
+	{ "pmr::unordered_map/monotonic", pmr_map_monotonic, pmr_map_region },
+};
+
+int
+main(void)
+{
+	double base, secs;
+	size_t i;
+
+	init_fsecs();
+	mem_init();
+	if (mm_init() < 0) {
+		fprintf(stderr, "mm_init failed\n");
+		return (EXIT_FAILURE);
+	}
+
+	printf("%-30s %12s %12s %8s\n", "workload", "default(us)", "mm(us)",
+	    "speedup");
+	for (i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+		base = fsecs(benches[i].baseline, NULL);
+		secs = fsecs(benches[i].subject, NULL);
+		printf("%-30s %12.1f %12.1f %7.2fx\n", benches[i].name,
+		    base * 1e6, secs * 1e6, base / secs);
+	}
+
+	return (EXIT_SUCCESS);
+}
@@ -0,0 +1,140 @@
+/*
+ * Replacements for the global C++ allocation operators that route every
+ * allocation through the allocator in mm.c.  Sized deletes go through
+ * mm_free_sized, so freeing a small object never reads its slab run's
+ * header.  The heap is set up on first use, so a program that links this
+ * in must not call mem_init or mm_init itself.  mm_new_test checks them.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+#include <pthread.h>
+
+extern "C" {
+#include "memlib.h"
+#include "mm.h"
+}
+
+static pthread_once_t heap_once = PTHREAD_ONCE_INIT;
+static bool heap_ready;
+
+/*
+ * Requires:
+ *   None.
+ *
+ * Effects:
+ *   Initialize the memory system and the memory manager.
+ */
+static void
+heap_init(void)
+{
+
+	mem_init();
+	heap_ready = (mm_init() == 0);
+}
+
+/*
+ * Requires:
+ *   None.
+ *
+ * Effects:
+ *   Allocate a block with at least "size" bytes of payload.  Unlike
+ *   mm_malloc, a zero-byte request still gets a unique block.  Every block
+ *   is 16-byte aligned, which is __STDCPP_DEFAULT_NEW_ALIGNMENT__ on
+ *   x86-64, so the operators without an alignment can use it.  Returns the
+ *   address of this block if successful and NULL otherwise.
+ */
+static void *
+allocate(std::size_t size)
+{
+
+	pthread_once(&heap_once, heap_init);
+	if (!heap_ready) {
+		return (NULL);
+	}
+
+	return (mm_malloc(size == 0 ? 1 : size));
+}
+
+void *
+operator new(std::size_t size)
+{
+	void *p;
+
+	if ((p = allocate(size)) == NULL) {
+		throw std::bad_alloc();
+	}
+
+	return (p);
+}
+
+void *
+operator new[](std::size_t size)
+{
+	void *p;
+
+	if ((p = allocate(size)) == NULL) {
+		throw std::bad_alloc();
+	}
+
+	return (p);
+}
+
+void *
+operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+
+	return (allocate(size));
+}
+
+void *
+operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+
+	return (allocate(size));
+}
+
+void
+operator delete(void *p) noexcept
+{
+
+	mm_free(p);
+}
+
+void
+operator delete[](void *p) noexcept
+{
+
+	mm_free(p);
+}
+
+void
+operator delete(void *p, const std::nothrow_t &) noexcept
+{
+
+	mm_free(p);
+}
+
+void
+operator delete[](void *p, const std::nothrow_t &) noexcept
+{
+
+	mm_free(p);
+}
+
+/* A zero-byte request was allocated as one byte, so it is freed as one. */
+void
+operator delete(void *p, std::size_t size) noexcept
+{
+
+	mm_free_sized(p, size == 0 ? 1 : size);
+}
+
+void
+operator delete[](void *p, std::size_t size) noexcept
+{
+
+	mm_free_sized(p, size == 0 ? 1 : size);
+}
@@ -0,0 +1,157 @@
+/*
+ * mm_new_test.cc - Checks the global operator new and delete replacements
+ * in mm_new.cc: every block comes from the heap in mm.c, is aligned for
+ * any fundamental type, and sized deletes reach mm_free_sized.
+ *
+ * The replacements set up the heap on first use, so this program never
+ * calls mem_init or mm_init itself.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+extern "C" {
+#include "mm.h"
+}
+
+#define NALLOCS	1000	/* Allocations made by each check */
+
+/* A type that needs the full default alignment of operator new. */
+struct alignas(alignof(std::max_align_t)) wide {
+	unsigned char bytes[48];
+};
+
+static int failures;
+
+/*
+ * Requires:
+ *   "what" is a string.
+ *
+ * Effects:
+ *   Report a failed check unless "ok" is true.
+ */
+static void
+check(bool ok, const char *what)
+{
+
+	if (!ok) {
+		printf("mm_new_test: FAILED: %s\n", what);
+		failures++;
+	}
+}
+
+/*
+ * Requires:
+ *   None.
+ *
+ * Effects:
+ *   Returns true if "p" is aligned for any fundamental type.
+ */
+static bool
+is_aligned(const void *p)
+{
+
+	return (reinterpret_cast<std::uintptr_t>(p) %
+	    alignof(std::max_align_t) == 0);
+}
+
+/*
+ * Requires:
+ *   None.
+ *
+ * Effects:
+ *   Allocate arrays and single objects of many sizes, from slab objects to
+ *   huge blocks, and check that each is aligned and comes from mm.c.
+ */
+static void
+check_alignment(void)
+{
+	static wide *arrays[NALLOCS];
+	static char *bytes[NALLOCS];
+	std::size_t n;
+	int i, misaligned;
+
+	misaligned = 0;
+	for (i = 0; i < NALLOCS; i++) {
+		n = 1 + (i * 37) % 4000;
+		arrays[i] = new wide[n];
+		bytes[i] = new char[n * 3];
+		misaligned += !is_aligned(arrays[i]) + !is_aligned(bytes[i]);
+		check(mm_usable_size(arrays[i]) >= n * sizeof(wide),
+		    "new[] is not served by mm_malloc");
+	}
+	check(misaligned == 0, "new returned a misaligned block");
+	for (i = 0; i < NALLOCS; i++) {
+		delete[] arrays[i];
+		delete[] bytes[i];
+	}
+}
+
+/*
+ * Requires:
+ *   None.
+ *
+ * Effects:
+ *   Check that a sized delete frees a small object into this thread's
+ *   cache, so the next allocation of its size gets it straight back, and
+ *   that a zero-byte allocation can be freed with its size.
+ */
+static void
+check_sized_delete(void)
+{
+	void *p, *q;
+
+	p = ::operator new(40);
+	::operator delete(p, 40);
+	q = ::operator new(40);
+	check(p == q, "sized delete did not reach the thread cache");
+	::operator delete(q, 40);
+
+	p = ::operator new(0);
+	check(p != NULL && is_aligned(p), "zero-byte new failed");
+	::operator delete(p, static_cast<std::size_t>(0));
+}
+
+/*
+ * Requires:
+ *   None.
+ *
+ * Effects:
+ *   Check that an impossible allocation throws, or returns NULL from the
+ *   nothrow form.
+ */
+static void
+check_failure(void)
+{
+	std::size_t huge;
+	bool thrown;
+
+	huge = SIZE_MAX / 2;
+	check(::operator new(huge, std::nothrow) == NULL,
+	    "nothrow new of an impossible size succeeded");
+	thrown = false;
+	try {
+		::operator delete(::operator new(huge));
+	} catch (const std::bad_alloc &) {
+		thrown = true;
+	}
+	check(thrown, "new of an impossible size did not throw");
+}
+
+int
+main(void)
+{
+
+	check_alignment();
+	check_sized_delete();
+	check_failure();
+	if (failures != 0) {
+		return (EXIT_FAILURE);
+	}
+	printf("mm_new_test: ok\n");
+
+	return (EXIT_SUCCESS);
+}
@@ -0,0 +1,385 @@
+/*
+ * Replacements for the C library's allocation functions that route every
+ * allocation through the allocator in mm.c.  Built as libmm.so, they can be
+ * interposed on an unmodified program with LD_PRELOAD.
+ *
+ * The heap is set up on first use.  Any allocation made while that is in
+ * progress, or from inside the allocator itself, is served from a small
+ * static arena instead, since the heap cannot serve it yet.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+
+#include "memlib.h"
+#include "mm.h"
+
+/* Basic constants: */
+#define BOOT_SIZE	(64 * 1024)	/* Static arena size (bytes) */
+#define BOOT_HDR	16		/* Size prefix before a payload */
+
+static pthread_once_t heap_once = PTHREAD_ONCE_INIT;
+static bool heap_ready;
+
+/* Nonzero while this thread is inside the allocator. */
+static __thread int depth;
+
+/* Allocations the heap cannot serve are bumped out of this arena. */
+static _Alignas(BOOT_HDR) char boot_heap[BOOT_SIZE];
+static size_t boot_used;
+
+/* Function prototypes for internal helper routines: */
+static void heap_init(void);
+static bool heap_enter(void);
+static void *boot_alloc(size_t size);
+static bool is_boot(void *ptr);
+
+/*
+ * Requires:
+ *   None.
+ *
+ * Effects:
+ *   Allocate a block with at least "size" bytes of payload, aligned for
+ *   any type as mm_malloc's blocks are.  Unlike mm_malloc, a zero-byte
+ *   request still gets a unique block.  Returns the address of this block
+ *   if successful and NULL otherwise.
+ */
+void *
+malloc(size_t size)
+{
+	void *p;
+
+	if (!heap_enter()) {
+		return (boot_alloc(size));
+	}
+	p = mm_malloc(size == 0 ? 1 : size);
+	depth--;
+	if (p == NULL) {
+		errno = ENOMEM;
+	}
+
+	return (p);
+}
+
+/*
+ * Requires:
+ *   "ptr" is NULL or was returned by one of these functions and has not
+ *   since been freed.
+ *
+ * Effects:
+ *   Free the block "ptr".  Blocks from the static arena are never reused.
+ */
+void
+free(void *ptr)
+{
+
+	// A reentrant free is leaked rather than risk taking a lock this
+	// thread already holds.
+	if (ptr == NULL || is_boot(ptr) || depth != 0) {
+		return;
+	}
+	// The heap exists, since this block came from it.
+	depth++;
+	mm_free(ptr);
+	depth--;
+}
+
+/*
+ * Requires:
+ *   None.
+ *
+ * Effects:
+ *   Allocate a zeroed block for an array of "nmemb" elements of "size"
+ *   bytes each.  Returns the address of this block if successful and NULL
+ *   otherwise.
+ */
+void *
+calloc(size_t nmemb, size_t size)
+{
+	void *p;
+
+	if (nmemb != 0 && size > SIZE_MAX / nmemb) {
+		errno = ENOMEM;
+		return (NULL);
+	}
+	if (!heap_enter()) {
+		// The static arena is zero until used and never reused.
+		return (boot_alloc(nmemb * size));
+	}
+	if (nmemb == 0 || size == 0) {
+		nmemb = size = 1;
+	}
+	p = mm_calloc(nmemb, size);
+	depth--;
+	if (p == NULL) {
+		errno = ENOMEM;
+	}
+
+	return (p);
+}
+
+/*
+ * Requires:
+ *   "ptr" is NULL or was returned by one of these functions and has not
+ *   since been freed.
+ *
+ * Effects:
+ *   Resize the block "ptr" to hold at least "size" bytes, like mm_realloc.
+ *   A block from the static arena is copied into the heap.  Returns the
+ *   address of the resized block, or NULL if "size" is zero or the block
+ *   could not be resized, in which case "ptr" is left untouched.
+ */
+void *
+realloc(void *ptr, size_t size)
+{
+	size_t oldsize;
+	void *p;
+
+	if (is_boot(ptr)) {
+		if (size == 0) {
+			return (NULL);
+		}
+		oldsize = *(size_t *)((char *)ptr - BOOT_HDR);
+		if ((p = malloc(size)) != NULL) {
+			memcpy(p, ptr, oldsize < size ? oldsize : size);
+		}
+		return (p);
+	}
+	if (!heap_enter()) {
+		return (ptr == NULL ? boot_alloc(size) : NULL);
+	}
+	p = mm_realloc(ptr, size);
+	depth--;
+	if (p == NULL && size != 0) {
+		errno = ENOMEM;
+	}
+
+	return (p);
+}
+
+/*
+ * Requires:
+ *   None.
+ *
+ * Effects:
+ *   Allocate a block with at least "size" bytes of payload that starts at a
+ *   multiple of "alignment" and store its address in "*memptr".
+ *   "alignment" must be a power of two multiple of sizeof(void *).
+ *   Returns 0 if successful, EINVAL if "alignment" is invalid and ENOMEM
+ *   otherwise.
+ */
+int
+posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+	void *p;
+
+	if (alignment < sizeof(void *) || (alignment & (alignment - 1)) != 0) {
+		return (EINVAL);
+	}
+	if (!heap_enter()) {
+		if (alignment > BOOT_HDR ||
+		    (p = boot_alloc(size)) == NULL) {
+			return (ENOMEM);
+		}
+		*memptr = p;
+		return (0);
+	}
+	p = mm_memalign(alignment, size == 0 ? 1 : size);
+	depth--;
+	if (p == NULL) {
+		return (ENOMEM);
+	}
+	*memptr = p;
+
+	return (0);
+}
+
+/*
+ * Requires:
+ *   None.
+ *
+ * Effects:
+ *   The C11 spelling of posix_memalign, which returns NULL on failure.
+ */
+void *
+aligned_alloc(size_t alignment, size_t size)
+{
+	void *p;
+	int error;
+
+	if ((error = posix_memalign(&p, alignment < sizeof(void *) ?
+	    sizeof(void *) : alignment, size)) != 0) {
+		errno = error;
+		return (NULL);
+	}
+
+	return (p);
+}
+
+/*
+ * Requires:
+ *   None.
+ *
+ * Effects:
+ *   The obsolete spelling of aligned_alloc.  It is still replaced, since
+ *   otherwise libc would hand out blocks that free cannot take.
+ */
+void *
+memalign(size_t alignment, size_t size)
+{
+
+	return (aligned_alloc(alignment, size));
+}
+
+/*
+ * Requires:
+ *   None.
+ *
+ * Effects:
+ *   Allocate a page-aligned block, like memalign.
+ */
+void *
+valloc(size_t size)
+{
+
+	return (aligned_alloc(mem_pagesize(), size));
+}
+
+/*
+ * Requires:
+ *   None.
+ *
+ * Effects:
+ *   Allocate a page-aligned block of whole pages, at least one, like
+ *   valloc.  It is replaced for the same reason as memalign.
+ */
+void *
+pvalloc(size_t size)
+{
+	size_t pagesize;
+
+	pagesize = mem_pagesize();
+	if (size > SIZE_MAX - (pagesize - 1)) {
+		errno = ENOMEM;
+		return (NULL);
+	}
+	size = (size + (pagesize - 1)) & ~(pagesize - 1);
+
+	return (valloc(size == 0 ? pagesize : size));
+}
+
+/*
+ * Requires:
+ *   "ptr" is NULL or was returned by one of these functions and has not
+ *   since been freed.
+ *
+ * Effects:
+ *   Returns the number of bytes of payload the block "ptr" really has.
+ */
+size_t
+malloc_usable_size(void *ptr)
+{
+
+	if (is_boot(ptr)) {
+		return (*(size_t *)((char *)ptr - BOOT_HDR));
+	}
+
+	return (mm_usable_size(ptr));
+}
+
+/*
+ * The following routines are internal helper routines.
+ */
+
+/*
+ * Requires:
+ *   None.
+ *
+ * Effects:
+ *   Initialize the memory system and the memory manager.  Allocations the
+ *   C library makes meanwhile on this thread go to the static arena.
+ */
+static void
+heap_init(void)
+{
+
+	depth++;
+	mem_init();
+	heap_ready = (mm_init() == 0);
+	depth--;
+}
+
+/*
+ * Requires:
+ *   None.
+ *
+ * Effects:
+ *   Enter the allocator, setting up the heap on first use.  Returns true
+ *   if the heap may be used, in which case the caller must decrement
+ *   "depth" on leaving, and false if this call is reentrant or the heap
+ *   could not be set up.
+ */
+static bool
+heap_enter(void)
+{
+
+	if (depth != 0) {
+		return (false);
+	}
+	pthread_once(&heap_once, heap_init);
+	if (!heap_ready) {
+		return (false);
+	}
+	depth++;
+
+	return (true);
+}
+
+/*
+ * Requires:
+ *   None.
+ *
+ * Effects:
+ *   Allocate a block with at least "size" bytes of payload from the static
+ *   arena.  Its size is stored just before it.  Returns the address of this
+ *   block if successful and NULL otherwise.
+ */
+static void *
+boot_alloc(size_t size)
+{
+	size_t asize, start;
+
+	if (size > BOOT_SIZE) {
+		errno = ENOMEM;
+		return (NULL);
+	}
+	asize = BOOT_HDR + ((size + (BOOT_HDR - 1)) & ~(size_t)(BOOT_HDR - 1));
+	start = __atomic_fetch_add(&boot_used, asize, __ATOMIC_RELAXED);
+	if (start + asize > BOOT_SIZE) {
+		errno = ENOMEM;
+		return (NULL);
+	}
+	*(size_t *)(boot_heap + start) = size;
+
+	return (boot_heap + start + BOOT_HDR);
+}
+
+/*
+ * Requires:
+ *   None.
+ *
+ * Effects:
+ *   Returns true if "ptr" was allocated from the static arena and false
+ *   otherwise.
+ */
+static bool
+is_boot(void *ptr)
+{
+
+	return ((char *)ptr >= boot_heap && (char *)ptr < boot_heap + BOOT_SIZE);
+}
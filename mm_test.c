@@ -0,0 +1,628 @@
+/*
+ * mm_test.c - Checks parts of the interface in mm.h that the trace
+ * replays in mdriver never reach.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "memlib.h"
+#include "mm.h"
+
+#define NBATCH	200	/* Blocks allocated by each batch */
+#define NPOOL	3000	/* Objects allocated from each pool */
+#define NGROW	16000	/* Blocks allocated while the heap grows */
+#define GROW_SIZE 3000	/* Size of each of these blocks */
+
+static int failures;
+
+/*
+ * Requires:
+ *   "what" is a string.
+ *
+ * Effects:
+ *   Report a failed check unless "ok" is true.
+ */
+static void
+check(bool ok, const char *what)
+{
+
+	if (!ok) {
+		printf("mm_test: FAILED: %s\n", what);
+		failures++;
+	}
+}
+
+/*
+ * Requires:
+ *   "p" has at least "n" bytes.
+ *
+ * Effects:
+ *   Returns true if the "n" bytes at "p" are all zero.
+ */
+static bool
+is_zero(const void *p, size_t n)
+{
+	const unsigned char *c;
+	size_t i;
+
+	c = p;
+	for (i = 0; i < n; i++) {
+		if (c[i] != 0) {
+			return (false);
+		}
+	}
+
+	return (true);
+}
+
+/*
+ * Requires:
+ *   The heap is initialized.
+ *
+ * Effects:
+ *   Check that a region refuses requests whose rounded size would wrap
+ *   around, and that it still hands out objects that do not overlap
+ *   afterwards.
+ */
+static void
+check_region_overflow(void)
+{
+	struct mm_region *region;
+	char *a, *b;
+
+	if ((region = mm_region_create()) == NULL) {
+		check(false, "mm_region_create failed");
+		return;
+	}
+	a = mm_region_alloc(region, 16);
+	check(mm_region_alloc(region, SIZE_MAX) == NULL,
+	    "region allocated SIZE_MAX bytes");
+	check(mm_region_alloc(region, SIZE_MAX - 20) == NULL,
+	    "region allocated SIZE_MAX - 20 bytes");
+	check(mm_region_alloc(region, SIZE_MAX / 2 + 1) == NULL,
+	    "region allocated half of the address space");
+	b = mm_region_alloc(region, 16);
+	check(a != NULL && b != NULL && b >= a + 16,
+	    "region handed out overlapping objects");
+	if (a != NULL && b != NULL) {
+		memset(a, 0xa5, 16);
+		memset(b, 0x5a, 16);
+		check(a[15] == (char)0xa5, "region objects overlap");
+	}
+	mm_region_destroy(region);
+}
+
+/*
+ * Requires:
+ *   The heap is initialized.
+ *
+ * Effects:
+ *   Check that mm_malloc_batch returns as many blocks as asked for, for
+ *   slab objects, heap blocks and huge blocks alike, each aligned, with
+ *   room for its payload and apart from the others, and that
+ *   mm_free_batch takes them all back.
+ */
+static void
+check_batch(void)
+{
+	static const struct {
+		size_t	size;
+		size_t	n;
+	} batches[] = {
+		{ 1, NBATCH }, { 24, NBATCH }, { 500, NBATCH }, { 513, NBATCH },
+		{ 3000, NBATCH }, { 70000, NBATCH }, { (size_t)40 << 20, 3 }
+	};
+	static void *out[NBATCH];
+	size_t i, j, got, size;
+	bool ok;
+
+	check(mm_malloc_batch(64, 0, out) == 0, "empty batch allocated");
+	for (i = 0; i < sizeof(batches) / sizeof(batches[0]); i++) {
+		size = batches[i].size;
+		got = mm_malloc_batch(size, batches[i].n, out);
+		check(got == batches[i].n, "batch returned too few blocks");
+		ok = true;
+		for (j = 0; j < got; j++) {
+			ok &= (uintptr_t)out[j] % 16 == 0 &&
+			    mm_usable_size(out[j]) >= size;
+			memset(out[j], (int)j, size);
+		}
+		for (j = 0; j < got; j++) {
+			ok &= ((unsigned char *)out[j])[0] == (unsigned char)j &&
+			    ((unsigned char *)out[j])[size - 1] ==
+			    (unsigned char)j;
+		}
+		check(ok, "batch blocks are misaligned, short or overlap");
+		mm_free_batch(out, got);
+	}
+}
+
+/*
+ * Requires:
+ *   The heap is initialized.
+ *
+ * Effects:
+ *   Check that mm_free_sized frees slab objects, heap blocks and huge
+ *   blocks, and that a slab object freed with its size goes to this
+ *   thread's cache, from which the next request of its size takes it.
+ */
+static void
+check_free_sized(void)
+{
+	static const size_t sizes[] = { 8, 40, 512, 600, 5000,
+	    (size_t)40 << 20 };
+	void *p, *q;
+	size_t i;
+
+	mm_free_sized(NULL, 0);
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		p = mm_malloc(sizes[i]);
+		check(p != NULL, "mm_malloc failed before mm_free_sized");
+		mm_free_sized(p, sizes[i]);
+		q = mm_malloc(sizes[i]);
+		check(q != NULL, "mm_malloc failed after mm_free_sized");
+		if (sizes[i] <= 512) {
+			check(p == q, "sized free missed the thread cache");
+		}
+		mm_free_sized(q, sizes[i]);
+	}
+}
+
+/*
+ * Requires:
+ *   The heap is initialized.
+ *
+ * Effects:
+ *   Allocate one block of each size in "sizes" at each alignment in
+ *   "aligns" into "out", and check that each is aligned and has room for
+ *   its payload.  If "trimmed" is true, also check that no more than a
+ *   few words of slack were left after the payload.  Returns the number
+ *   of blocks allocated.
+ */
+static size_t
+alloc_aligned(const size_t *aligns, size_t naligns, const size_t *sizes,
+    size_t nsizes, bool trimmed, void **out)
+{
+	size_t i, j, n;
+	bool ok;
+
+	n = 0;
+	ok = true;
+	for (i = 0; i < naligns; i++) {
+		for (j = 0; j < nsizes; j++) {
+			out[n] = (n % 2 == 0) ?
+			    mm_memalign(aligns[i], sizes[j]) :
+			    mm_aligned_alloc(aligns[i], sizes[j]);
+			if (out[n] == NULL) {
+				ok = false;
+				continue;
+			}
+			ok &= (uintptr_t)out[n] % aligns[i] == 0 &&
+			    mm_usable_size(out[n]) >= sizes[j] &&
+			    (!trimmed || mm_usable_size(out[n]) < sizes[j] + 64);
+			memset(out[n], 0xa5, sizes[j]);
+			n++;
+		}
+	}
+	check(ok, "aligned block is misaligned, short or missing");
+
+	return (n);
+}
+
+/*
+ * Requires:
+ *   The heap is initialized.
+ *
+ * Effects:
+ *   Check mm_memalign and mm_aligned_alloc at alignments from below
+ *   ALIGNMENT to well above a page, that they refuse an alignment that is
+ *   not a power of two.  The slack around an aligned heap block must be
+ *   freed, so the block is hardly larger than its payload and a second
+ *   round of the same requests needs no more heap.
+ */
+static void
+check_memalign(void)
+{
+	static const size_t aligns[] = { 1, 8, 16, 32, 64, 256, 4096,
+	    8192, (size_t)1 << 20 };
+	static const size_t heap_aligns[] = { 32, 64, 256, 1024, 4096 };
+	static const size_t sizes[] = { 1, 100, 3000, 70000 };
+	static void *out[64];
+	size_t heap, i, n;
+
+	check(mm_memalign(0, 64) == NULL, "alignment 0 accepted");
+	check(mm_memalign(48, 64) == NULL, "alignment 48 accepted");
+	check(mm_aligned_alloc(64, 0) == NULL, "zero-byte aligned block");
+
+	n = alloc_aligned(aligns, sizeof(aligns) / sizeof(aligns[0]), sizes,
+	    sizeof(sizes) / sizeof(sizes[0]), false, out);
+	for (i = 0; i < n; i++) {
+		mm_free(out[i]);
+	}
+
+	for (i = 0; i < 2; i++) {
+		n = alloc_aligned(heap_aligns,
+		    sizeof(heap_aligns) / sizeof(heap_aligns[0]), sizes,
+		    sizeof(sizes) / sizeof(sizes[0]), true, out);
+		while (n > 0) {
+			mm_free(out[--n]);
+		}
+		mm_tcache_flush();
+		if (i == 0) {
+			heap = mem_heapsize();
+		}
+	}
+	check(mem_heapsize() == heap, "aligned slack was not reused");
+}
+
+/*
+ * Requires:
+ *   The heap is initialized.
+ *
+ * Effects:
+ *   Check that mm_calloc zeroes blocks that reuse dirty memory, blocks
+ *   carved from fresh memory, huge blocks, and blocks that reuse pages
+ *   mm_trim gave back, and that it refuses a product that overflows.
+ *   A block reusing released pages must also hold what is written to it.
+ */
+static void
+check_calloc(void)
+{
+	static const size_t sizes[] = { 1, 40, 512, 600, 3000, 70000,
+	    (size_t)1 << 20, (size_t)3 << 20, (size_t)40 << 20 };
+	unsigned char *p;
+	size_t i, size;
+	bool ok;
+
+	check(mm_calloc(SIZE_MAX / 2, 3) == NULL, "calloc overflow accepted");
+	check(mm_calloc(0, 16) == NULL, "zero-byte calloc");
+
+	ok = true;
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		size = sizes[i];
+		// Fresh, or at least not ours to have dirtied.
+		if ((p = mm_calloc(1, size)) == NULL) {
+			ok = false;
+			continue;
+		}
+		ok &= is_zero(p, size);
+		memset(p, 0xff, size);
+		mm_free(p);
+		// Most likely the same memory, now dirty.
+		if ((p = mm_calloc(size, 1)) == NULL) {
+			ok = false;
+			continue;
+		}
+		ok &= is_zero(p, size);
+		memset(p, 0xff, size);
+		mm_free(p);
+	}
+	check(ok, "calloc returned memory that is not zero");
+
+	// Pages inside a large free block are released and then reused.
+	size = (size_t)2 << 20;
+	p = mm_malloc(size);
+	check(p != NULL, "mm_malloc failed before mm_trim");
+	memset(p, 0xff, size);
+	mm_free(p);
+	mm_trim(0);
+	p = mm_calloc(1, size);
+	check(p != NULL && is_zero(p, size), "calloc after mm_trim not zero");
+	mm_free(p);
+	mm_trim(0);
+	p = mm_malloc(size);
+	check(p != NULL, "mm_malloc failed after mm_trim");
+	if (p != NULL) {
+		memset(p, 0x5a, size);
+		check(p[0] == 0x5a && p[size / 2] == 0x5a &&
+		    p[size - 1] == 0x5a, "released pages lost a write");
+		mm_free(p);
+	}
+}
+
+/*
+ * Requires:
+ *   The heap is initialized and no block from it is in use.
+ *
+ * Effects:
+ *   Start over with an empty heap, so that the blocks of earlier checks
+ *   cannot serve later requests.
+ */
+static void
+reset_heap(void)
+{
+
+	mem_reset_brk();
+	check(mm_init() == 0, "mm_init failed on an empty heap");
+}
+
+/*
+ * Requires:
+ *   "a" and "b" point to pointers.
+ *
+ * Effects:
+ *   Compares the pointers for qsort.
+ */
+static int
+ptr_cmp(const void *a, const void *b)
+{
+	uintptr_t x, y;
+
+	x = (uintptr_t)*(void *const *)a;
+	y = (uintptr_t)*(void *const *)b;
+
+	return ((x > y) - (x < y));
+}
+
+/*
+ * Requires:
+ *   The heap is initialized.
+ *
+ * Effects:
+ *   Check that pools refuse bad arguments, hand out aligned objects that
+ *   do not overlap, and hand a freed object out again.
+ */
+static void
+check_pool(void)
+{
+	static const struct {
+		size_t size, align;
+	} pools[] = { { 1, 0 }, { 24, 0 }, { 24, 64 }, { 100, 16 },
+	    { 5000, 4096 } };
+	static unsigned char *objs[NPOOL], *freed[NPOOL / 2];
+	struct mm_pool *pool;
+	size_t align, i, j, size;
+	bool ok;
+
+	check(mm_pool_create(0, 0) == NULL, "zero-byte pool");
+	check(mm_pool_create(24, 48) == NULL, "pool alignment 48 accepted");
+	check(mm_pool_create(24, 8192) == NULL,
+	    "pool alignment above a page accepted");
+
+	for (i = 0; i < sizeof(pools) / sizeof(pools[0]); i++) {
+		size = pools[i].size;
+		align = pools[i].align != 0 ? pools[i].align : 16;
+		if ((pool = mm_pool_create(size, pools[i].align)) == NULL) {
+			check(false, "mm_pool_create failed");
+			continue;
+		}
+		ok = true;
+		for (j = 0; j < NPOOL; j++) {
+			if ((objs[j] = mm_pool_alloc(pool)) == NULL) {
+				ok = false;
+				break;
+			}
+			ok &= (uintptr_t)objs[j] % align == 0;
+			memset(objs[j], (int)j, size);
+		}
+		check(ok, "pool object missing or misaligned");
+		if (!ok) {
+			mm_pool_destroy(pool);
+			continue;
+		}
+		// An overlapping object would have overwritten another.
+		for (j = 0; j < NPOOL; j++) {
+			ok &= objs[j][0] == (unsigned char)j &&
+			    objs[j][size - 1] == (unsigned char)j;
+		}
+		check(ok, "pool objects overlap");
+
+		mm_pool_free(pool, objs[NPOOL / 2]);
+		check(mm_pool_alloc(pool) == objs[NPOOL / 2],
+		    "freed pool object not reused");
+		// Objects freed in a batch all come back before any new one.
+		for (j = 0; j < NPOOL / 2; j++) {
+			freed[j] = objs[2 * j];
+			mm_pool_free(pool, freed[j]);
+		}
+		for (j = 0; j < NPOOL / 2; j++) {
+			objs[j] = mm_pool_alloc(pool);
+		}
+		qsort(freed, NPOOL / 2, sizeof(freed[0]), ptr_cmp);
+		qsort(objs, NPOOL / 2, sizeof(objs[0]), ptr_cmp);
+		check(memcmp(freed, objs, NPOOL / 2 * sizeof(objs[0])) == 0,
+		    "pool did not reuse freed objects");
+		mm_pool_destroy(pool);
+	}
+}
+
+/*
+ * Requires:
+ *   The heap is initialized.
+ *
+ * Effects:
+ *   Check that a request the free top block cannot hold grows the heap by
+ *   only what that block lacks, and that growth steps under the default
+ *   policy keep the heap close to the payload it holds.
+ */
+static void
+check_heap_growth(void)
+{
+	static void *blocks[NGROW];
+	size_t grown, i, size;
+	char *p, *q;
+	bool ok;
+
+	// With no growth steps, only the shortfall should be added.  A block
+	// as large as the heap cannot fit in any free block but the top one.
+	mm_set_heap_growth(0, 1);
+	mm_set_mmap_threshold(SIZE_MAX);
+	size = mem_heapsize();
+	p = mm_malloc(size);
+	check(p != NULL, "mm_malloc failed before growing the top block");
+	mm_free(p);
+	grown = mem_heapsize();
+	q = mm_malloc(2 * size);
+	check(q != NULL && q <= p, "top block not merged with new memory");
+	grown = mem_heapsize() - grown;
+	check(grown <= size, "heap grew by more than the top block lacked");
+	mm_free(q);
+	mm_trim(0);
+	mm_set_mmap_threshold((size_t)1 << 25);
+
+	// Steps double but stay a small part of the heap.
+	mm_set_heap_growth((size_t)1 << 26, 32);
+	grown = mem_heapsize();
+	ok = true;
+	for (i = 0; i < NGROW; i++) {
+		ok &= (blocks[i] = mm_malloc(GROW_SIZE)) != NULL;
+	}
+	check(ok, "mm_malloc failed while growing the heap");
+	grown = mem_heapsize() - grown;
+	check(grown <= (size_t)NGROW * GROW_SIZE / 10 * 11,
+	    "heap grew far past its payload");
+	for (i = 0; i < NGROW; i++) {
+		mm_free(blocks[i]);
+	}
+	mm_trim(0);
+}
+
+/*
+ * Requires:
+ *   The heap is initialized and no block from it is in use.
+ *
+ * Effects:
+ *   Check that a free block between two allocated ones is split even
+ *   when it is less than twice the request, that a large request takes
+ *   its high end and a small one its low end, and that the split
+ *   threshold decides when the request gets the whole block.
+ */
+static void
+check_placement(void)
+{
+	char *hole, *high, *low, *left, *right;
+	size_t hsize;
+
+	reset_heap();
+	left = mm_malloc(600);
+	hole = mm_malloc(8000);
+	right = mm_malloc(600);
+	check(left != NULL && hole != NULL && right != NULL,
+	    "mm_malloc failed before placement");
+	hsize = mm_usable_size(hole);
+	mm_free(hole);
+
+	high = mm_malloc(6500);
+	check(high > hole && right - (high + mm_usable_size(high)) < 16,
+	    "large block not placed at the high end");
+	low = mm_malloc(1000);
+	check(low == hole, "small block not placed at the low end");
+	check(mm_usable_size(low) < 1200, "small block not split");
+	mm_free(low);
+	mm_free(high);
+
+	mm_set_split_threshold(4096);
+	high = mm_malloc(5000);
+	check(high == hole && mm_usable_size(high) == hsize,
+	    "block split below the split threshold");
+	mm_free(high);
+	mm_set_split_threshold(16);
+	high = mm_malloc(5000);
+	check(high != NULL && mm_usable_size(high) < hsize,
+	    "block not split above the split threshold");
+	mm_free(high);
+	mm_free(left);
+	mm_free(right);
+}
+
+/*
+ * Requires:
+ *   The heap is initialized and no block from it is in use.
+ *
+ * Effects:
+ *   Check that mm_set_config refuses an invalid order without changing
+ *   the configuration, that mm_get_config returns what was set, and that
+ *   each order hands out freed blocks of one size as it promises.
+ */
+static void
+check_config(void)
+{
+	static const struct {
+		enum mm_order order;
+		int expect[3];	/* Indices into "blocks" in allocation order */
+	} orders[] = {
+		{ MM_ORDER_FIFO, { 2, 0, 1 } },
+		{ MM_ORDER_LIFO, { 1, 0, 2 } },
+		{ MM_ORDER_ADDRESS, { 0, 1, 2 } },
+	};
+	struct mm_config defaults, cfg, got;
+	void *blocks[3], *guards[4];
+	size_t i, j;
+	bool ok;
+
+	mm_get_config(&defaults);
+	cfg = defaults;
+	cfg.order[3] = MM_ORDER_ADDRESS;
+	cfg.fit_scan = defaults.fit_scan + 1;
+	check(mm_set_config(&cfg) == 0, "mm_set_config refused a config");
+	mm_get_config(&got);
+	check(memcmp(&cfg, &got, sizeof(cfg)) == 0,
+	    "mm_get_config did not return what was set");
+	cfg.order[7] = (enum mm_order)(MM_ORDER_ADDRESS + 1);
+	check(mm_set_config(&cfg) == -1, "invalid order accepted");
+	mm_get_config(&cfg);
+	check(memcmp(&cfg, &got, sizeof(cfg)) == 0,
+	    "refused config changed the config");
+
+	// 600-byte blocks come from the heap and share one exact bin.  The
+	// guards keep them from coalescing.
+	reset_heap();
+	ok = true;
+	for (i = 0; i < 3; i++) {
+		ok &= (guards[i] = mm_malloc(600)) != NULL;
+		ok &= (blocks[i] = mm_malloc(600)) != NULL;
+	}
+	ok &= (guards[3] = mm_malloc(600)) != NULL;
+	check(ok, "mm_malloc failed before testing orders");
+	for (i = 0; i < sizeof(orders) / sizeof(orders[0]); i++) {
+		cfg = defaults;
+		cfg.order[5] = orders[i].order;
+		mm_set_config(&cfg);
+		mm_free(blocks[2]);
+		mm_free(blocks[0]);
+		mm_free(blocks[1]);
+		ok = true;
+		for (j = 0; j < 3; j++) {
+			ok &= mm_malloc(600) == blocks[orders[i].expect[j]];
+		}
+		check(ok, "freed blocks not handed out in the set order");
+	}
+	for (i = 0; i < 4; i++) {
+		mm_free(guards[i]);
+	}
+	for (i = 0; i < 3; i++) {
+		mm_free(blocks[i]);
+	}
+	mm_set_config(&defaults);
+}
+
+int
+main(void)
+{
+
+	mem_init();
+	if (mm_init() < 0) {
+		fprintf(stderr, "mm_init failed\n");
+		return (EXIT_FAILURE);
+	}
+
+	check_region_overflow();
+	check_batch();
+	check_free_sized();
+	check_memalign();
+	check_calloc();
+	check_pool();
+	check_heap_growth();
+	check_placement();
+	check_config();
+	if (failures != 0) {
+		return (EXIT_FAILURE);
+	}
+	printf("mm_test: ok\n");
+
+	return (EXIT_SUCCESS);
+}